@@ -0,0 +1,178 @@
+/* HomeSpan Cryptographic Benchmark Example */
+
+// This is a stand-alone sketch that measures the time taken by each of the
+// cryptographic operations HomeSpan performs during Pair-Setup, Pair-Verify,
+// and encrypted HAP sessions.  It does not create a HomeKit device.  Upload
+// it to any ESP32 and open the Serial Monitor.  Each operation is repeated
+// a fixed number of times with fixed inputs, and the minimum, median, average,
+// and maximum time per call (in microseconds) is printed, along with the
+// number of operations per second.  Run it before and after any change to
+// HomeSpan's cryptography to check for improvements or regressions.
+//
+// The SRP-6A steps are checked for correctness by also performing the
+// Controller's side of the exchange and confirming both sides derive
+// the same shared secret.
+//
+// The packing and unpacking of typical Pair-Setup and Pair-Verify TLV8
+// messages is also timed, since every pairing step performs both.
+
+#include "HomeSpan.h"
+#include "SRP.h"
+#include "HKDF.h"
+#include "HAP.h"
+#include <sodium.h>
+
+SRP6A srp;                      // separate SRP-6A structure so that HomeSpan's own pairing data is not disturbed
+HKDF hkdf;
+HapTLV tlv(hapTLVRecords);      // separate TLV8 structure, with same records as HAPClient::tlv8
+
+const char *setupCode="46637726";
+
+////////////////////////////////////
+
+template <class opType>
+void bench(const char *name, int n, opType op){
+
+  uint32_t t[n];
+
+  for(int i=0;i<n;i++){
+    uint32_t start=micros();
+    op();
+    t[i]=micros()-start;
+  }
+
+  for(int i=1;i<n;i++){                       // insertion sort (n is small)
+    uint32_t x=t[i];
+    int j=i-1;
+    for(;j>=0 && t[j]>x;j--)
+      t[j+1]=t[j];
+    t[j+1]=x;
+  }
+
+  uint64_t total=0;
+  for(int i=0;i<n;i++)
+    total+=t[i];
+
+  char buf[128];
+  sprintf(buf,"%-32s %6d %10u %10u %10llu %10u %10.1f\n",name,n,t[0],t[n/2],total/n,t[n-1],total?n*1.0e6/total:0);
+  Serial.print(buf);
+}
+
+////////////////////////////////////
+
+void setup() {
+
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.print("\n\nHomeSpan Cryptographic Benchmarks (times in microseconds)\n\n");
+
+  char buf[128];
+  sprintf(buf,"%-32s %6s %10s %10s %10s %10s %10s\n","Operation","Count","Min","Median","Average","Max","Ops/sec");
+  Serial.print(buf);
+
+  // Pair-Setup: SRP-6A
+
+  uint8_t verifyCode[384];
+  uint8_t salt[16];
+
+  bench("SRP createVerifyCode ('S')",5,[&](){srp.createVerifyCode(setupCode,verifyCode,salt);});
+  bench("SRP loadVerifyCode (boot)",5,[&](){srp.loadVerifyCode(verifyCode,salt);});
+  bench("SRP precomputePublicKey (M1)",5,[&](){srp.precomputePublicKey();});
+
+  mbedtls_mpi a, e, t, Sc;              // Controller's private key, exponent, temporary, and premaster secret
+  mbedtls_mpi_init(&a);
+  mbedtls_mpi_init(&e);
+  mbedtls_mpi_init(&t);
+  mbedtls_mpi_init(&Sc);
+
+  uint8_t aBuf[32];
+  randombytes_buf(aBuf,32);
+  mbedtls_mpi_read_binary(&a,aBuf,32);
+  mbedtls_mpi_exp_mod(&srp.A,&srp.g,&a,&srp.N,&srp._rr);         // A = g^a %N
+
+  bench("SRP createSessionKey (M3)",5,[&](){srp.createSessionKey();});
+
+  // Controller computes S = (B - kv)^(a + ux) %N, which must match the Accessory's S
+  
+  mbedtls_mpi_sub_mpi(&t,&srp.B,&srp.kv);
+  if(mbedtls_mpi_cmp_int(&t,0)<0)
+    mbedtls_mpi_add_mpi(&t,&t,&srp.N);
+  mbedtls_mpi_mul_mpi(&e,&srp.u,&srp.x);
+  mbedtls_mpi_add_mpi(&e,&e,&a);
+  mbedtls_mpi_exp_mod(&Sc,&t,&e,&srp.N,&srp._rr);
+
+  Serial.print(mbedtls_mpi_cmp_mpi(&Sc,&srp.S)?"** ERROR: SRP shared secrets do NOT match!\n":"   (SRP shared secrets match)\n");
+
+  srp.verifyProof();                                  // compute M1V, and use it as the Controller's proof M1 for the benchmark
+  mbedtls_mpi_copy(&srp.M1,&srp.M1V);
+
+  bench("SRP verifyProof (M3)",20,[&](){srp.verifyProof();});
+  bench("SRP createProof (M3)",20,[&](){srp.createProof();});
+
+  uint8_t key[32];
+  
+  bench("HKDF create",100,[&](){hkdf.create(key,srp.sharedSecret,64,"Pair-Setup-Encrypt-Salt","Pair-Setup-Encrypt-Info");});
+
+  // Pair-Setup and Pair-Verify: Ed25519 and Curve25519
+
+  uint8_t LTPK[32], LTSK[64], sig[64], info[100];
+  memset(info,0x55,sizeof(info));
+  crypto_sign_keypair(LTPK,LTSK);
+
+  bench("Ed25519 sign",20,[&](){crypto_sign_detached(sig,NULL,info,sizeof(info),LTSK);});
+  bench("Ed25519 verify",20,[&](){crypto_sign_verify_detached(sig,info,sizeof(info),LTPK);});
+
+  uint8_t pubKey[32], secKey[32], iosKey[32], shared[32];
+  crypto_box_keypair(iosKey,secKey);
+
+  bench("Curve25519 keypair (M1)",20,[&](){crypto_box_keypair(pubKey,secKey);});
+  bench("Curve25519 shared secret (M1)",20,[&](){crypto_scalarmult_curve25519(shared,secKey,iosKey);});
+
+  // Encrypted sessions: one full HAP frame (2-byte AAD + 1024 bytes + 16-byte tag)
+
+  uint8_t frame[2+1024+16], plain[1024], nonce[12]={0};
+  unsigned long long len;
+  memset(plain,0x33,sizeof(plain));
+  frame[0]=0x00;
+  frame[1]=0x04;
+
+  bench("ChaCha20-Poly1305 encrypt 1K",200,[&](){crypto_aead_chacha20poly1305_ietf_encrypt(frame+2,&len,plain,1024,frame,2,NULL,nonce,key);});
+  bench("ChaCha20-Poly1305 decrypt 1K",200,[&](){crypto_aead_chacha20poly1305_ietf_decrypt(plain,&len,NULL,frame+2,1024+16,frame,2,nonce,key);});
+
+  // TLV8 messages: pack (response) and unpack (request) of typical Pair-Setup <M2>/<M4>/<M6> and Pair-Verify <M2> messages
+
+  struct {
+    const char *name;
+    int pubKeyLen, saltLen, proofLen, encLen;
+  } msgs[]={
+    {"Pair-Setup <M2>",384,16,0,0},
+    {"Pair-Setup <M4>",0,0,64,0},
+    {"Pair-Setup <M6>",0,0,0,154},
+    {"Pair-Verify <M2>",32,0,0,120}
+  };
+
+  uint8_t msgBuf[1024];
+  
+  for(auto &msg : msgs){
+    tlv.clear();
+    tlv.val(kTLVType_State,2);
+    memset(tlv.buf(kTLVType_PublicKey,msg.pubKeyLen),0x11,msg.pubKeyLen);
+    memset(tlv.buf(kTLVType_Salt,msg.saltLen),0x22,msg.saltLen);
+    memset(tlv.buf(kTLVType_Proof,msg.proofLen),0x33,msg.proofLen);
+    memset(tlv.buf(kTLVType_EncryptedData,msg.encLen),0x44,msg.encLen);
+    int nBytes=tlv.pack(msgBuf);
+
+    sprintf(buf,"TLV pack %s (%d)",msg.name,nBytes);
+    bench(buf,200,[&](){tlv.pack(msgBuf);});
+    sprintf(buf,"TLV unpack %s (%d)",msg.name,nBytes);
+    bench(buf,200,[&](){tlv.unpack(msgBuf,nBytes);});
+  }
+  
+  Serial.print("\nDone!\n");
+}
+
+////////////////////////////////////
+
+void loop(){
+}
@@ -0,0 +1,70 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Timing helper shared by the host benchmarks.  bench() runs an operation a fixed number of times and prints the
+//  minimum, median, average, and maximum time per call (in microseconds), along with the number of calls per second,
+//  in the same format as the CryptoBenchmark example sketch so results from the host and an ESP32 can be compared.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+inline void benchHeader(const char *title){
+
+  printf("\n%s (times in microseconds)\n\n",title);
+  printf("%-36s %8s %10s %10s %10s %10s %12s\n","Operation","Count","Min","Median","Average","Max","Ops/sec");
+}
+
+// times n runs of 'batch' back-to-back calls to op, and reports the time per call
+
+template <class opType>
+void bench(const char *name, int n, opType op, int batch=1){
+
+  std::vector<double> t(n);
+
+  for(int i=0;i<n;i++){
+    auto start=std::chrono::steady_clock::now();
+    for(int j=0;j<batch;j++)
+      op();
+    t[i]=std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count()/batch;
+  }
+
+  std::sort(t.begin(),t.end());
+
+  double total=0;
+  for(int i=0;i<n;i++)
+    total+=t[i];
+
+  printf("%-36s %8d %10.3f %10.3f %10.3f %10.3f %12.0f\n",name,n*batch,t[0],t[n/2],total/n,t[n-1],total>0?n*1.0e6/total:0);
+}
@@ -0,0 +1,157 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Fixed-base comb exponentiation against mbedtls_mpi_exp_mod() for the SRP-6A group (RFC 5054 3072-bit N, g=5).
+//
+//  SRP6A computes g^b (256-bit b) for every Pair-Setup and g^x (512-bit x) for every new Setup Code.  Since g and N
+//  are fixed, g^e could instead use a Lim-Lee comb: with window h and a=ceil(t/h) for a t-bit exponent, the table
+//  G[j] = product of g^(2^(i*a)) over the bits i set in j (2^h entries of 384 bytes) reduces g^e to a squarings and
+//  a multiplications.  mbedtls keeps its Montgomery multiplication internal, so a comb built on the public API has to
+//  reduce each product with mbedtls_mpi_mod_mpi(), which is what this benchmark measures for several window sizes.
+//  Every comb result is checked against mbedtls_mpi_exp_mod().
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "HomeSpan.h"
+#include "SRP.h"
+#include "Bench.h"
+#include <sodium.h>
+
+struct Comb {
+
+  int h;                                    // window width (bits)
+  int a;                                    // number of comb columns = ceil(t/h)
+  std::vector<mbedtls_mpi> G;               // table of 2^h precomputed powers of g
+  const mbedtls_mpi *N;
+  mbedtls_mpi t;                            // scratch for products before reduction
+
+  Comb(const mbedtls_mpi *g, const mbedtls_mpi *N, int h, int tBits) : h(h), a((tBits+h-1)/h), G(1<<h), N(N) {
+
+    mbedtls_mpi_init(&t);
+    for(auto &x : G)
+      mbedtls_mpi_init(&x);
+
+    mbedtls_mpi e;
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_lset(&G[0],1);
+
+    for(int i=0;i<h;i++){                   // G[2^i] = g^(2^(i*a))
+      mbedtls_mpi_lset(&e,1);
+      mbedtls_mpi_shift_l(&e,i*a);
+      mbedtls_mpi_exp_mod(&G[1<<i],g,&e,N,NULL);
+    }
+
+    for(int j=1;j<(1<<h);j++){              // G[j] = G[j without its top bit] * G[top bit of j]
+      int top=1;
+      while(top*2<=j)
+        top*=2;
+      if(j!=top){
+        mbedtls_mpi_mul_mpi(&t,&G[j-top],&G[top]);
+        mbedtls_mpi_mod_mpi(&G[j],&t,N);
+      }
+    }
+
+    mbedtls_mpi_free(&e);
+  }
+
+  ~Comb(){
+    mbedtls_mpi_free(&t);
+    for(auto &x : G)
+      mbedtls_mpi_free(&x);
+  }
+
+  void exp(mbedtls_mpi *R, const mbedtls_mpi *e){       // R = g^e %N
+
+    mbedtls_mpi_lset(R,1);
+
+    for(int k=a-1;k>=0;k--){
+      mbedtls_mpi_mul_mpi(&t,R,R);
+      mbedtls_mpi_mod_mpi(R,&t,N);
+      int idx=0;
+      for(int i=0;i<h;i++)
+        idx|=mbedtls_mpi_get_bit(e,k+i*a)<<i;
+      if(idx){
+        mbedtls_mpi_mul_mpi(&t,R,&G[idx]);
+        mbedtls_mpi_mod_mpi(R,&t,N);
+      }
+    }
+  }
+
+  size_t tableBytes(){return(G.size()*384);}
+};
+
+int main(){
+
+  if(sodium_init()<0)
+    return(1);
+
+  SRP6A srp;                                            // provides N and g exactly as used by HomeSpan
+
+  mbedtls_mpi e, R1, R2, RR;
+  mbedtls_mpi_init(&e);
+  mbedtls_mpi_init(&R1);
+  mbedtls_mpi_init(&R2);
+  mbedtls_mpi_init(&RR);
+
+  uint8_t eBuf[64];
+  char name[64];
+
+  for(int tBits : {256,512}){                           // g^b for Pair-Setup <M2>, and g^x for a new Setup Code
+
+    printf("\n%d-bit exponent (%s)\n",tBits,tBits==256?"g^b, every Pair-Setup":"g^x, every new Setup Code");
+    benchHeader("g^e mod N");
+
+    randombytes_buf(eBuf,tBits/8);
+    mbedtls_mpi_read_binary(&e,eBuf,tBits/8);
+
+    bench("mbedtls_mpi_exp_mod",50,[&](){mbedtls_mpi_exp_mod(&R1,&srp.g,&e,&srp.N,&RR);});
+
+    for(int h : {4,6,8}){
+
+      Comb comb(&srp.g,&srp.N,h,tBits);
+
+      for(int i=0;i<20;i++){                            // check comb against mbedtls_mpi_exp_mod for random exponents
+        randombytes_buf(eBuf,tBits/8);
+        mbedtls_mpi_read_binary(&e,eBuf,tBits/8);
+        mbedtls_mpi_exp_mod(&R1,&srp.g,&e,&srp.N,&RR);
+        comb.exp(&R2,&e);
+        if(mbedtls_mpi_cmp_mpi(&R1,&R2)){
+          printf("*** ERROR: comb (h=%d) and mbedtls_mpi_exp_mod disagree\n",h);
+          return(1);
+        }
+      }
+
+      sprintf(name,"comb h=%d (%u KB table)",h,(unsigned)(comb.tableBytes()/1024));
+      bench(name,50,[&](){comb.exp(&R2,&e);});
+    }
+  }
+
+  printf("\n");
+  return(0);
+}
@@ -0,0 +1,131 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Span::find() lookup cost against HAP database size.
+//
+//  Grows a bridge-style database one Accessory at a time (AccessoryInformation plus a dimmable LightBulb, so 10 iids
+//  per Accessory) and, at each size, times random aid/iid lookups with the indexed Span::find() and with the linear
+//  scan it replaced.  The indexed lookup should stay flat as the database grows, while the scan grows with the number
+//  of Accessories and with the position of the iid within its Accessory.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "HomeSpan.h"
+#include "Bench.h"
+
+// the linear scan used by Span::find() before aidIndex and iidTable were added
+
+static SpanCharacteristic *linearFind(uint32_t aid, int iid){
+
+  int index=-1;
+  for(int i=0;i<homeSpan.Accessories.size();i++){   // loop over all Accessories to find aid
+    if(homeSpan.Accessories[i]->aid==aid){          // if match, save index into Accessories array
+      index=i;
+      break;
+    }
+  }
+
+  if(index<0)                  // fail if no match on aid
+    return(NULL);
+    
+  for(int i=0;i<homeSpan.Accessories[index]->Services.size();i++){                           // loop over all Services in this Accessory
+    for(int j=0;j<homeSpan.Accessories[index]->Services[i]->Characteristics.size();j++){     // loop over all Characteristics in this Service
+      if(iid == homeSpan.Accessories[index]->Services[i]->Characteristics[j]->iid)           // if matching iid
+        return(homeSpan.Accessories[index]->Services[i]->Characteristics[j]);                // return pointer to Characteristic
+    }
+  }
+
+  return(NULL);
+}
+
+static void addAccessory(){
+
+  new SpanAccessory();
+    new Service::AccessoryInformation();
+      new Characteristic::Name("Light");
+      new Characteristic::Manufacturer("HomeSpan");
+      new Characteristic::SerialNumber("123-ABC");
+      new Characteristic::Model("Benchmark");
+      new Characteristic::FirmwareRevision("1.0");
+      new Characteristic::Identify();
+    new Service::LightBulb();
+      new Characteristic::On();
+      new Characteristic::Brightness();
+}
+
+int main(){
+
+  const int sizes[]={1,10,25,50,100,150};           // number of Accessories (HAP allows a bridge to have up to 150)
+  const int nKeys=4096;                             // random aid/iid pairs looked up in each timed batch
+
+  benchHeader("Span::find() lookup cost against database size");
+
+  std::vector<uint32_t> aids(nKeys);
+  std::vector<int> iids(nKeys);
+  uint32_t seed=1;
+  volatile uintptr_t sink=0;                        // results are folded into sink so that lookups are not optimized away
+
+  for(int size : sizes){
+
+    while(homeSpan.Accessories.size()<size)
+      addAccessory();
+    homeSpan.buildIndex();
+
+    std::vector<SpanCharacteristic *> chars;                             // every Characteristic in the database
+    for(auto acc : homeSpan.Accessories)
+      for(auto svc : acc->Services)
+        for(auto chr : svc->Characteristics)
+          chars.push_back(chr);
+
+    for(int i=0;i<nKeys;i++){                                            // random lookups, as made by GET/PUT /characteristics
+      seed=seed*1103515245+12345;
+      SpanCharacteristic *c=chars[(seed>>8)%chars.size()];
+      aids[i]=c->aid;
+      iids[i]=c->iid;
+    }
+
+    for(int i=0;i<nKeys;i++){                                            // confirm both lookups agree
+      if(homeSpan.find(aids[i],iids[i])!=linearFind(aids[i],iids[i])){
+        printf("*** ERROR: find() and linear scan disagree for aid=%u iid=%d\n",aids[i],iids[i]);
+        return(1);
+      }
+    }
+
+    char name[64];
+    int k=0;
+
+    sprintf(name,"find() indexed, %d Accessories",size);
+    bench(name,200,[&](){sink=sink^(uintptr_t)homeSpan.find(aids[k],iids[k]);k=(k+1)%nKeys;},nKeys);
+    sprintf(name,"find() linear scan, %d Accessories",size);
+    bench(name,200,[&](){sink=sink^(uintptr_t)linearFind(aids[k],iids[k]);k=(k+1)%nKeys;},nKeys);
+  }
+
+  printf("\n");
+  return(0);
+}
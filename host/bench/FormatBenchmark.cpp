@@ -0,0 +1,127 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Characteristic value formatting: JsonWriter's integer and float kernels against the snprintf() calls they replaced
+//  in SpanCharacteristic::sprintfAttributes(), for each Characteristic FORMAT.
+//
+//  Before timing, every FLOAT value written by JsonWriter::addFloat() is read back with strtod() to confirm it
+//  reproduces the original double exactly, and is checked to be no longer than the shortest round-trip text found by
+//  trying "%.{1..17}g" in increasing precision.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "HomeSpan.h"
+#include "Bench.h"
+
+static uint64_t seed=1;
+
+static uint64_t rnd(){                              // 64-bit LCG (MMIX constants) - fixed seed so every run formats the same values
+  seed=seed*6364136223846793005ULL+1442695040888963407ULL;
+  return(seed);
+}
+
+int main(){
+
+  const int nVals=1024;
+
+  std::vector<boolean> bVals(nVals);
+  std::vector<int32_t> iVals(nVals);
+  std::vector<uint8_t> u8Vals(nVals);
+  std::vector<uint16_t> u16Vals(nVals);
+  std::vector<uint32_t> u32Vals(nVals);
+  std::vector<uint64_t> u64Vals(nVals);
+  std::vector<double> fTypical(nVals);
+  std::vector<double> fRandom(nVals);
+
+  for(int i=0;i<nVals;i++){
+    bVals[i]=rnd()>>63;
+    iVals[i]=(int32_t)(rnd()>>32)>>(rnd()>>59);     // mix of small and large magnitudes
+    u8Vals[i]=rnd()>>56;
+    u16Vals[i]=rnd()>>48;
+    u32Vals[i]=(rnd()>>32)>>(rnd()>>59);
+    u64Vals[i]=rnd()>>(rnd()>>58);
+    fTypical[i]=(int)(rnd()%2000-1000)/10.0;        // e.g. CurrentTemperature in steps of 0.1
+    fRandom[i]=((rnd()>>11)*0x1.0p-53-0.5)*pow(10,(int)(rnd()%12)-4);     // arbitrary doubles needing up to 17 significant digits
+  }
+
+  const double edge[]={0.1+0.2,1e-7,1.5e-12,-2.5e-300,1e22,123456789012345680000.0,1.7976931348623157e308,4.9e-324,21.123456789,-0.001};
+  for(int i=0;i<sizeof(edge)/sizeof(edge[0]);i++)   // include some values that need exponents or all 17 digits
+    fRandom[i]=edge[i];
+
+  // check FLOAT values round-trip, and are no longer than the shortest %.{1..17}g text
+
+  JsonWriter json;
+  char buf[32];
+  int nChecked=0;
+
+  for(auto vals : {&fTypical,&fRandom}){
+    for(double x : *vals){
+      json.clear();
+      json.addFloat(x);
+      int shortest=0;
+      for(int prec=1;prec<=17;prec++){
+        shortest=sprintf(buf,"%.*g",prec,x);
+        if(strtod(buf,NULL)==x)
+          break;
+      }
+      if(strtod(json.buf,NULL)!=x || json.len>shortest){
+        printf("*** ERROR: addFloat(%.17g) wrote \"%s\" (shortest round-trip is \"%s\")\n",x,json.buf,buf);
+        return(1);
+      }
+      nChecked++;
+    }
+  }
+
+  printf("\nChecked %d FLOAT values: all round-trip exactly, with no more characters than the shortest %%.{1..17}g\n",nChecked);
+
+  benchHeader("Characteristic value formatting");
+
+  int k=0;
+  char cBuf[64];
+  volatile int sink=0;                              // lengths are folded into sink so that formatting is not optimized away
+
+  #define BENCH_PAIR(FMT,VALS,JSONCALL,PRINTF) \
+    bench(FMT " JsonWriter",200,[&](){json.clear();json.JSONCALL(VALS[k]);sink=sink+json.len;k=(k+1)%nVals;},nVals); \
+    bench(FMT " snprintf(" PRINTF ")",200,[&](){sink=sink+snprintf(cBuf,64,PRINTF,VALS[k]);k=(k+1)%nVals;},nVals);
+
+  bench("BOOL JsonWriter",200,[&](){json.clear();json.addBool(bVals[k]);sink=sink+json.len;k=(k+1)%nVals;},nVals);
+  bench("BOOL snprintf(\"%s\")",200,[&](){sink=sink+snprintf(cBuf,64,"%s",bVals[k]?"true":"false");k=(k+1)%nVals;},nVals);
+  BENCH_PAIR("INT",iVals,addInt,"%d")
+  BENCH_PAIR("UINT8",u8Vals,addUInt,"%u")
+  BENCH_PAIR("UINT16",u16Vals,addUInt,"%u")
+  BENCH_PAIR("UINT32",u32Vals,addUInt,"%u")
+  BENCH_PAIR("UINT64",u64Vals,addUInt,"%llu")
+  BENCH_PAIR("FLOAT (0.1 steps)",fTypical,addFloat,"%lg")
+  bench("FLOAT (0.1 steps) snprintf(%.17g)",200,[&](){sink=sink+snprintf(cBuf,64,"%.17g",fTypical[k]);k=(k+1)%nVals;},nVals);
+  BENCH_PAIR("FLOAT (random)",fRandom,addFloat,"%lg")
+  bench("FLOAT (random) snprintf(%.17g)",200,[&](){sink=sink+snprintf(cBuf,64,"%.17g",fRandom[k]);k=(k+1)%nVals;},nVals);
+
+  printf("\n%%lg is shown for reference only, since it keeps just 6 significant digits and does not round-trip.\n\n");
+  return(0);
+}
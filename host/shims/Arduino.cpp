@@ -0,0 +1,219 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#include <Arduino.h>
+#include <driver/timer.h>
+#include <stdarg.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sodium.h>
+
+char **hostArgv=NULL;                   // arguments of this process (saved by main) for use by ESP.restart()
+
+HardwareSerial Serial;
+EspClass ESP;
+timg_dev_t TIMERG0;
+timg_dev_t TIMERG1;
+
+//////////////////////////////////////
+
+static uint64_t clockMicros(){
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000+ts.tv_nsec/1000);
+}
+
+static const uint64_t startMicros=clockMicros();
+
+unsigned long millis(){
+  return((clockMicros()-startMicros)/1000);
+}
+
+unsigned long micros(){
+  return(clockMicros()-startMicros);
+}
+
+void delay(uint32_t ms){
+  usleep(ms*1000);
+}
+
+void delayMicroseconds(uint32_t us){
+  usleep(us);
+}
+
+//////////////////////////////////////
+
+void pinMode(uint8_t pin, uint8_t mode){}
+void digitalWrite(uint8_t pin, uint8_t val){}
+int digitalRead(uint8_t pin){return(HIGH);}
+void analogWrite(uint8_t pin, int val){}
+
+//////////////////////////////////////
+
+long random(long max){
+  return(max>0?randombytes_uniform(max):0);
+}
+
+long random(long min, long max){
+  return(max>min?min+random(max-min):min);
+}
+
+uint32_t esp_random(){
+  return(randombytes_random());
+}
+
+const char *esp_get_idf_version(){
+  return("host");
+}
+
+//////////////////////////////////////
+
+size_t Print::write(const uint8_t *buf, size_t size){
+
+  size_t n=0;
+  while(size--)
+    n+=write(*buf++);
+  return(n);
+}
+
+size_t Print::printNumber(unsigned long long n, int base){
+
+  char buf[8*sizeof(n)+1];
+  char *c=buf+sizeof(buf);
+
+  *--c='\0';
+  do {
+    int d=n%base;
+    *--c=d<10?'0'+d:'A'+d-10;
+    n/=base;
+  } while(n);
+
+  return(write(c));
+}
+
+size_t Print::print(long long n, int base){
+
+  if(n<0 && base==10)
+    return(print('-')+printNumber(-(unsigned long long)n,base));
+    
+  return(printNumber(n,base));
+}
+
+size_t Print::print(double x, int digits){
+
+  char buf[64];
+  snprintf(buf,sizeof(buf),"%.*f",digits,x);
+  return(write(buf));
+}
+
+size_t Print::printf(const char *format, ...){
+
+  char buf[256];
+  va_list args;
+  
+  va_start(args,format);
+  int n=vsnprintf(buf,sizeof(buf),format,args);
+  va_end(args);
+
+  if(n<(int)sizeof(buf))
+    return(write(buf));
+
+  char *big=(char *)malloc(n+1);
+  va_start(args,format);
+  vsnprintf(big,n+1,format,args);
+  va_end(args);
+  n=write(big);
+  free(big);
+  return(n);
+}
+
+//////////////////////////////////////
+
+static int pendingByte=-1;                            // byte read from stdin by available() but not yet returned by read()
+static bool stdinClosed=false;                        // set once end-of-file is reached on stdin
+
+int HardwareSerial::available(){
+
+  if(pendingByte>=0)
+    return(1);
+
+  if(stdinClosed)
+    return(0);
+
+  struct pollfd pfd={STDIN_FILENO,POLLIN,0};
+  
+  if(poll(&pfd,1,0)<=0 || !(pfd.revents&(POLLIN|POLLHUP)))
+    return(0);
+
+  uint8_t c;
+  
+  if(::read(STDIN_FILENO,&c,1)!=1){                   // end of file - ignore stdin from now on (e.g. when running in the background)
+    stdinClosed=true;
+    return(0);
+  }
+
+  pendingByte=c;
+  return(1);
+}
+
+int HardwareSerial::read(){
+
+  if(!available())
+    return(-1);
+
+  int c=pendingByte;
+  pendingByte=-1;
+  return(c);
+}
+
+//////////////////////////////////////
+
+size_t HardwareSerial::write(uint8_t c){
+  return(write(&c,1));
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size){
+  return(fwrite(buf,1,size,stdout));
+}
+
+//////////////////////////////////////
+
+void EspClass::restart(){
+
+  Serial.print("\n*** Restarting host process...\n\n");
+  fflush(stdout);
+  if(hostArgv)
+    execv("/proc/self/exe",hostArgv);
+  exit(1);                                            // only reached if execv() fails
+}
+
+uint32_t EspClass::getFreeHeap(){
+  return(mallinfo2().fordblks);
+}
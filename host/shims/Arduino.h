@@ -0,0 +1,185 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Host (Linux) replacement for the subset of the Arduino-ESP32 core used by HomeSpan:
+//
+//  millis/micros/delay     - based on the POSIX monotonic clock
+//  pinMode/digitalRead/... - no-ops (all pins read HIGH, so PushButtons are never pressed)
+//  String                  - std::string-based replacement for the Arduino String class
+//  Print/Serial            - Serial writes to stdout and reads (non-blocking) from stdin
+//  ESP                     - restart() re-executes the current process
+//  heap_caps_*             - plain malloc/realloc/free
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+#include <vector>                        // the ESP32 core pulls <vector> and <algorithm> in indirectly, and HomeSpan relies on it
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH          0x1
+#define LOW           0x0
+#define INPUT         0x01
+#define OUTPUT        0x02
+#define INPUT_PULLUP  0x05
+#define LED_BUILTIN   2
+
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+long random(long max);
+long random(long min, long max);
+
+uint32_t esp_random();
+const char *esp_get_idf_version();
+
+#define MALLOC_CAP_8BIT (1<<2)
+
+inline void *heap_caps_malloc(size_t size, uint32_t caps){return(malloc(size));}
+inline void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps){return(realloc(ptr,size));}
+inline void heap_caps_free(void *ptr){free(ptr);}
+
+//////////////////////////////////////
+
+class String {
+
+  std::string s;
+
+  public:
+
+  String(const char *c=""){s=c?c:"";}
+  String(const std::string &c) : s(c) {}
+  explicit String(char c) : s(1,c) {}
+  explicit String(int n) : s(std::to_string(n)) {}
+  explicit String(unsigned int n) : s(std::to_string(n)) {}
+  explicit String(long n) : s(std::to_string(n)) {}
+  explicit String(unsigned long n) : s(std::to_string(n)) {}
+  explicit String(long long n) : s(std::to_string(n)) {}
+  explicit String(unsigned long long n) : s(std::to_string(n)) {}
+  explicit String(double x, unsigned int decimals=2){char c[64]; snprintf(c,sizeof(c),"%.*f",decimals,x); s=c;}
+
+  String &operator+=(const String &rhs){s+=rhs.s; return(*this);}
+  String &operator+=(const char *rhs){s+=rhs; return(*this);}
+  String &operator+=(char rhs){s+=rhs; return(*this);}
+  friend String operator+(const String &lhs, const String &rhs){return(String(lhs.s+rhs.s));}
+  friend String operator+(const char *lhs, const String &rhs){return(String(lhs+rhs.s));}
+  friend String operator+(const String &lhs, const char *rhs){return(String(lhs.s+rhs));}
+  bool operator==(const String &rhs) const {return(s==rhs.s);}
+  bool operator==(const char *rhs) const {return(s==rhs);}
+
+  const char *c_str() const {return(s.c_str());}
+  unsigned int length() const {return(s.length());}
+  char operator[](unsigned int i) const {return(s[i]);}
+};
+
+//////////////////////////////////////
+
+class Print;
+
+class Printable {
+  public:
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+
+  size_t printNumber(unsigned long long n, int base);
+
+  public:
+  
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size);
+  size_t write(const char *s){return(write((const uint8_t *)s,strlen(s)));}
+
+  size_t print(const char *s){return(write(s));}
+  size_t print(const String &s){return(write(s.c_str()));}
+  size_t print(char c){return(write((uint8_t)c));}
+  size_t print(unsigned char n, int base=DEC){return(printNumber(n,base));}
+  size_t print(int n, int base=DEC){return(print((long long)n,base));}
+  size_t print(unsigned int n, int base=DEC){return(printNumber(n,base));}
+  size_t print(long n, int base=DEC){return(print((long long)n,base));}
+  size_t print(unsigned long n, int base=DEC){return(printNumber(n,base));}
+  size_t print(long long n, int base=DEC);
+  size_t print(unsigned long long n, int base=DEC){return(printNumber(n,base));}
+  size_t print(double x, int digits=2);
+  size_t print(const Printable &x){return(x.printTo(*this));}
+
+  template <class T> size_t println(const T &x){size_t n=print(x); return(n+println());}
+  size_t println(){return(write("\r\n"));}
+  size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+};
+
+//////////////////////////////////////
+
+class HardwareSerial : public Print {
+
+  public:
+
+  void begin(unsigned long baud){}
+  void setDebugOutput(bool enable){}
+  int available();                                          // number of bytes waiting on stdin (never blocks)
+  int read();                                               // next byte from stdin, or -1 if none
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+//////////////////////////////////////
+
+struct EspClass {
+  void restart();                                           // re-executes the current process with its original arguments
+  uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,77 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#include <ESPmDNS.h>
+#include <map>
+#include <string>
+
+MDNSResponder MDNS;
+
+static std::map<std::string,std::string> txtRecords;      // TXT records of the (single) HAP service
+
+static bool logChanges(){
+  return(getenv("HOMESPAN_MDNS_LOG")!=NULL);
+}
+
+//////////////////////////////////////
+
+bool MDNSResponder::begin(const char *hostName){
+
+  if(logChanges())
+    Serial.printf("[mDNS] host name: %s.local\n",hostName);
+  return(true);
+}
+
+//////////////////////////////////////
+
+void MDNSResponder::setInstanceName(const char *name){
+
+  if(logChanges())
+    Serial.printf("[mDNS] instance name: %s\n",name);
+}
+
+//////////////////////////////////////
+
+bool MDNSResponder::addService(const char *service, const char *proto, uint16_t port){
+
+  if(logChanges())
+    Serial.printf("[mDNS] service: %s.%s port %u\n",service,proto,port);
+  return(true);
+}
+
+//////////////////////////////////////
+
+esp_err_t mdns_service_txt_item_set(const char *service, const char *proto, const char *key, const char *value){
+
+  std::string &v=txtRecords[key];
+  
+  if(v!=value && logChanges())
+    Serial.printf("[mDNS] %s.%s TXT %s=%s\n",service,proto,key,value);
+
+  v=value;
+  return(0);
+}
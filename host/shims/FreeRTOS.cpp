@@ -0,0 +1,109 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#include <freertos/task.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+struct HostTask {
+  std::mutex mtx;
+  std::condition_variable cv;
+  uint32_t notifyCount=0;             // pending task notifications
+};
+
+static HostTask mainTask;                                 // task handle for the thread that runs setup() and loop()
+static thread_local HostTask *currentTask=&mainTask;
+
+//////////////////////////////////////
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t taskCode, const char *name, uint32_t stackDepth, void *params, UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreID){
+
+  HostTask *task=new HostTask;          // never deleted - tasks run until the process exits
+  
+  if(createdTask)
+    *createdTask=task;
+
+  std::thread([=](){
+    currentTask=task;
+    taskCode(params);
+  }).detach();
+  
+  return(pdPASS);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t taskCode, const char *name, uint32_t stackDepth, void *params, UBaseType_t priority, TaskHandle_t *createdTask){
+  return(xTaskCreatePinnedToCore(taskCode,name,stackDepth,params,priority,createdTask,tskNO_AFFINITY));
+}
+
+//////////////////////////////////////
+
+TaskHandle_t xTaskGetCurrentTaskHandle(){
+  return(currentTask);
+}
+
+//////////////////////////////////////
+
+void vTaskDelay(TickType_t ticks){
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks*portTICK_PERIOD_MS));
+}
+
+//////////////////////////////////////
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait){
+
+  HostTask *task=currentTask;
+  std::unique_lock<std::mutex> lock(task->mtx);
+
+  auto ready=[task](){return(task->notifyCount>0);};
+  
+  if(ticksToWait==portMAX_DELAY)
+    task->cv.wait(lock,ready);
+  else
+    task->cv.wait_for(lock,std::chrono::milliseconds(ticksToWait*portTICK_PERIOD_MS),ready);
+
+  uint32_t count=task->notifyCount;
+  
+  if(count)
+    task->notifyCount=clearCountOnExit?0:count-1;
+    
+  return(count);
+}
+
+//////////////////////////////////////
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+
+  {
+    std::lock_guard<std::mutex> lock(task->mtx);
+    task->notifyCount++;
+  }
+  
+  task->cv.notify_one();
+  return(pdPASS);
+}
@@ -0,0 +1,335 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <ifaddrs.h>
+#include <fcntl.h>
+#include <errno.h>
+
+WiFiClass WiFi;
+
+////////////////////////////////
+//         IPAddress          //
+////////////////////////////////
+
+size_t IPAddress::printTo(Print &p) const {
+  return(p.print(toString()));
+}
+
+String IPAddress::toString() const {
+
+  char buf[16];
+  sprintf(buf,"%u.%u.%u.%u",addr[0],addr[1],addr[2],addr[3]);
+  return(String(buf));
+}
+
+////////////////////////////////
+//         WiFiClient         //
+////////////////////////////////
+
+WiFiClient::Socket::~Socket(){
+  close(fd);
+}
+
+//////////////////////////////////////
+
+WiFiClient::WiFiClient(int fd){
+
+  if(fd<0)
+    return;
+
+  sock=std::make_shared<Socket>(fd);
+  isConnected=true;
+}
+
+//////////////////////////////////////
+
+int WiFiClient::connect(const char *host, uint16_t port){
+
+  struct addrinfo hints={}, *res;
+  char portStr[8];
+
+  hints.ai_family=AF_INET;
+  hints.ai_socktype=SOCK_STREAM;
+  sprintf(portStr,"%u",port);
+
+  if(getaddrinfo(host,portStr,&hints,&res))
+    return(0);
+
+  int fd=socket(res->ai_family,res->ai_socktype,res->ai_protocol);
+
+  if(fd<0 || ::connect(fd,res->ai_addr,res->ai_addrlen)<0){
+    if(fd>=0)
+      close(fd);
+    freeaddrinfo(res);
+    return(0);
+  }
+
+  freeaddrinfo(res);
+  *this=WiFiClient(fd);
+  return(1);
+}
+
+//////////////////////////////////////
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size){
+
+  if(!sock)
+    return(0);
+
+  size_t nSent=0;
+
+  while(nSent<size){
+    int n=send(sock->fd,buf+nSent,size-nSent,MSG_NOSIGNAL);
+    if(n<0){
+      if(errno==EINTR)
+        continue;
+      isConnected=false;
+      break;
+    }
+    nSent+=n;
+  }
+
+  return(nSent);
+}
+
+//////////////////////////////////////
+
+int WiFiClient::available(){
+
+  int nBytes=0;
+  
+  if(!sock || ioctl(sock->fd,FIONREAD,&nBytes)<0)
+    return(0);
+
+  return(nBytes);
+}
+
+//////////////////////////////////////
+
+int WiFiClient::read(){
+
+  uint8_t c;
+  return(read(&c,1)==1?c:-1);
+}
+
+//////////////////////////////////////
+
+int WiFiClient::read(uint8_t *buf, size_t size){
+
+  if(!sock)
+    return(-1);
+
+  int n=recv(sock->fd,buf,size,MSG_DONTWAIT);
+
+  if(n<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR)
+    isConnected=false;
+
+  return(n>0?n:-1);
+}
+
+//////////////////////////////////////
+
+int WiFiClient::peek(){
+
+  uint8_t c;
+  return(sock && recv(sock->fd,&c,1,MSG_PEEK|MSG_DONTWAIT)==1?c:-1);
+}
+
+//////////////////////////////////////
+
+void WiFiClient::stop(){
+
+  sock.reset();
+  isConnected=false;
+}
+
+//////////////////////////////////////
+
+uint8_t WiFiClient::connected(){
+
+  if(!sock || !isConnected)
+    return(0);
+
+  uint8_t c;
+  
+  if(recv(sock->fd,&c,1,MSG_PEEK|MSG_DONTWAIT)<0){        // check for fatal errors in the same way as the ESP32
+    switch(errno){
+      case ENOTCONN:
+      case EPIPE:
+      case ECONNRESET:
+      case ECONNREFUSED:
+      case ECONNABORTED:
+        isConnected=false;
+      break;
+    }
+  }
+
+  return(isConnected);
+}
+
+//////////////////////////////////////
+
+int WiFiClient::setNoDelay(bool nodelay){
+
+  int flag=nodelay;
+  return(sock?setsockopt(sock->fd,IPPROTO_TCP,TCP_NODELAY,&flag,sizeof(flag)):-1);
+}
+
+//////////////////////////////////////
+
+IPAddress WiFiClient::remoteIP() const {
+
+  struct sockaddr_in addr;
+  socklen_t len=sizeof(addr);
+
+  if(!sock || getpeername(sock->fd,(struct sockaddr *)&addr,&len)<0 || addr.sin_family!=AF_INET)
+    return(IPAddress());
+
+  return(IPAddress(addr.sin_addr.s_addr));
+}
+
+//////////////////////////////////////
+
+uint16_t WiFiClient::remotePort() const {
+
+  struct sockaddr_in addr;
+  socklen_t len=sizeof(addr);
+
+  if(!sock || getpeername(sock->fd,(struct sockaddr *)&addr,&len)<0 || addr.sin_family!=AF_INET)
+    return(0);
+
+  return(ntohs(addr.sin_port));
+}
+
+////////////////////////////////
+//         WiFiServer         //
+////////////////////////////////
+
+void WiFiServer::begin(uint16_t port){
+
+  if(port)
+    this->port=port;
+
+  const char *envPort=getenv("HOMESPAN_PORT");
+  if(envPort)
+    this->port=atoi(envPort);
+
+  end();
+  
+  sockfd=socket(AF_INET,SOCK_STREAM,0);
+
+  int flag=1;
+  setsockopt(sockfd,SOL_SOCKET,SO_REUSEADDR,&flag,sizeof(flag));
+
+  struct sockaddr_in addr={};
+  addr.sin_family=AF_INET;
+  addr.sin_addr.s_addr=htonl(INADDR_ANY);
+  addr.sin_port=htons(this->port);
+
+  if(bind(sockfd,(struct sockaddr *)&addr,sizeof(addr))<0 || listen(sockfd,SOMAXCONN)<0){
+    Serial.printf("\n*** ERROR: Can't listen on TCP port %u: %s\n\n",this->port,strerror(errno));
+    end();
+    return;
+  }
+
+  fcntl(sockfd,F_SETFL,fcntl(sockfd,F_GETFL)|O_NONBLOCK);     // so available() never blocks
+}
+
+//////////////////////////////////////
+
+void WiFiServer::end(){
+
+  if(sockfd>=0)
+    close(sockfd);
+  sockfd=-1;
+}
+
+//////////////////////////////////////
+
+WiFiClient WiFiServer::available(){
+
+  if(sockfd<0)
+    return(WiFiClient());
+
+  int fd=accept(sockfd,NULL,NULL);        // accepted sockets are blocking, even though the listening socket is not
+  
+  if(fd<0)
+    return(WiFiClient());
+
+  WiFiClient client(fd);
+  
+  if(noDelay)
+    client.setNoDelay(true);
+    
+  return(client);
+}
+
+//////////////////////////////////////
+
+bool WiFiServer::hasClient(){
+
+  fd_set readSet;
+  struct timeval tv={0,0};
+
+  if(sockfd<0)
+    return(false);
+    
+  FD_ZERO(&readSet);
+  FD_SET(sockfd,&readSet);
+  return(select(sockfd+1,&readSet,NULL,NULL,&tv)>0);
+}
+
+////////////////////////////////
+//         WiFiClass          //
+////////////////////////////////
+
+IPAddress WiFiClass::localIP(){
+
+  struct ifaddrs *ifList;
+  IPAddress ip(127,0,0,1);
+
+  if(getifaddrs(&ifList))
+    return(ip);
+
+  for(struct ifaddrs *ifa=ifList;ifa;ifa=ifa->ifa_next){
+    if(ifa->ifa_addr && ifa->ifa_addr->sa_family==AF_INET){
+      uint32_t a=((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr;
+      if((ntohl(a)>>24)!=127){
+        ip=IPAddress(a);
+        break;
+      }
+    }
+  }
+
+  freeifaddrs(ifList);
+  return(ip);
+}
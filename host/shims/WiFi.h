@@ -0,0 +1,153 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Host (Linux) replacement for the Arduino-ESP32 WiFi library:
+//
+//  IPAddress    - IPv4 address that can be printed with Serial.print()
+//  WiFiClient   - TCP connection over a POSIX socket.  Copies share the same socket (as on the ESP32), and stop()
+//                 closes it for all copies
+//  WiFiServer   - listening TCP socket.  The port can be over-ridden with the HOMESPAN_PORT environment variable
+//                 so that many instances can run on one host without root privileges
+//  WiFi         - the host network is always "connected"; Access Point functions are no-ops
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+
+typedef enum {
+  WL_IDLE_STATUS=0,
+  WL_NO_SSID_AVAIL=1,
+  WL_SCAN_COMPLETED=2,
+  WL_CONNECTED=3,
+  WL_CONNECT_FAILED=4,
+  WL_CONNECTION_LOST=5,
+  WL_DISCONNECTED=6
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF=0,
+  WIFI_STA=1,
+  WIFI_AP=2,
+  WIFI_AP_STA=3
+} wifi_mode_t;
+
+//////////////////////////////////////
+
+class IPAddress : public Printable {
+
+  uint8_t addr[4];
+
+  public:
+
+  IPAddress(){memset(addr,0,4);}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d){addr[0]=a; addr[1]=b; addr[2]=c; addr[3]=d;}
+  IPAddress(uint32_t a){memcpy(addr,&a,4);}                 // network byte order, as stored in sockaddr_in
+  operator uint32_t() const {uint32_t a; memcpy(&a,addr,4); return(a);}
+  uint8_t operator[](int i) const {return(addr[i]);}
+  size_t printTo(Print &p) const;
+  String toString() const;
+};
+
+//////////////////////////////////////
+
+class WiFiClient : public Print {
+
+  struct Socket {
+    int fd;
+    Socket(int fd) : fd(fd) {}
+    ~Socket();                                              // closes socket once the last copy of the client is stopped or destroyed
+  };
+
+  std::shared_ptr<Socket> sock;                             // socket shared by all copies of this client (NULL if none)
+  bool isConnected=false;                                   // cleared by stop() or by a fatal socket error (as on the ESP32, end-of-file alone does not clear it)
+
+  public:
+
+  WiFiClient(){}
+  WiFiClient(int fd);                                       // takes ownership of a connected socket (fd<0 creates an empty client)
+
+  int connect(const char *host, uint16_t port);             // returns 1 if connected, else 0
+  size_t write(uint8_t c){return(write(&c,1));}
+  size_t write(const uint8_t *buf, size_t size);            // blocks until all bytes are sent (or the connection fails)
+  using Print::write;
+  int available();                                          // number of bytes that can be read without blocking
+  int read();                                               // next byte, or -1 if none available
+  int read(uint8_t *buf, size_t size);                      // up to size bytes that are available without blocking, or -1 if none
+  int peek();
+  void flush(){}
+  void stop();
+  uint8_t connected();                                      // 0 once stop() has been called or the connection has failed
+  operator bool(){return(connected());}
+  int fd() const {return(sock?sock->fd:-1);}
+  int setNoDelay(bool nodelay);
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+  bool operator==(const WiFiClient &rhs) const {return(sock==rhs.sock);}
+};
+
+//////////////////////////////////////
+
+class WiFiServer {
+
+  uint16_t port;
+  int sockfd=-1;
+  bool noDelay=false;
+
+  public:
+
+  WiFiServer(uint16_t port=80) : port(port) {}
+  ~WiFiServer(){end();}
+  
+  void begin(uint16_t port=0);
+  void end();
+  WiFiClient available();                                   // returns next pending connection (or an empty client if none)
+  bool hasClient();
+  void setNoDelay(bool nodelay){noDelay=nodelay;}
+  operator bool(){return(sockfd>=0);}
+};
+
+//////////////////////////////////////
+
+struct WiFiClass {
+
+  wl_status_t status(){return(WL_CONNECTED);}
+  wl_status_t begin(const char *ssid, const char *passphrase=NULL){return(WL_CONNECTED);}
+  bool disconnect(bool wifioff=false){return(true);}
+  bool mode(wifi_mode_t m){return(true);}
+  bool softAP(const char *ssid, const char *passphrase=NULL){return(true);}
+  bool softAPdisconnect(bool wifioff=false){return(true);}
+  int16_t scanNetworks(){return(0);}
+  String SSID(uint8_t i=0){return(String("HomeSpan-Host"));}
+  IPAddress localIP();                                      // first non-loopback IPv4 address of this host (or 127.0.0.1)
+};
+
+extern WiFiClass WiFi;
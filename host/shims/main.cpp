@@ -0,0 +1,79 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Entry point of a HomeSpan sketch built for the host.  Calls the sketch's setup() once and then loop() forever,
+//  as the Arduino-ESP32 core does.  The host network is always "connected", so the WiFi credentials are set to a
+//  placeholder unless credentials have already been saved in NVS.
+//
+//  Environment variables:
+//
+//    HOMESPAN_PORT     - TCP port of the HAP server (default 80)
+//    HOMESPAN_NVS      - directory holding the NVS files (default ./homespan_nvs)
+//    HOMESPAN_IDLE_US  - microseconds to sleep after each call to loop() (default 0 - spin, as on the ESP32)
+//    HOMESPAN_MDNS_LOG - if set, log mDNS host name, service, and TXT record changes
+//    HOMESPAN_AUTOPOLL - if set, call homeSpan.autoPoll() after setup(), so HAP requests are handled in their own thread
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "HomeSpan.h"
+#include <sodium.h>
+#include <unistd.h>
+
+void setup();
+void loop();
+
+extern char **hostArgv;
+
+int main(int argc, char **argv){
+
+  hostArgv=argv;
+  setvbuf(stdout,NULL,_IOLBF,0);
+
+  if(sodium_init()<0){
+    fprintf(stderr,"*** ERROR: Can't initialize libsodium\n");
+    return(1);
+  }
+
+  if(!strlen(homeSpan.network.wifiData.ssid))
+    strcpy(homeSpan.network.wifiData.ssid,"HomeSpan-Host");     // replaced by any credentials saved in NVS when HAPClient::init() runs
+
+  const char *idle=getenv("HOMESPAN_IDLE_US");
+  useconds_t idleTime=idle?atoi(idle):0;
+
+  setup();
+
+  if(getenv("HOMESPAN_AUTOPOLL"))
+    homeSpan.autoPoll();
+
+  for(;;){
+    loop();
+    if(idleTime)
+      usleep(idleTime);
+  }
+}
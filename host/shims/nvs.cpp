@@ -0,0 +1,169 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#include <nvs_flash.h>
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+static std::vector<std::string> namespaces;               // namespace of each open handle (handle=index+1)
+
+static std::string nvsDir(){
+
+  const char *dir=getenv("HOMESPAN_NVS");
+  return(dir?dir:"homespan_nvs");
+}
+
+static std::string *findNamespace(nvs_handle handle){
+  return(handle>0 && handle<=namespaces.size()?&namespaces[handle-1]:NULL);
+}
+
+static std::string blobPath(nvs_handle handle, const char *key){
+  return(nvsDir()+"/"+*findNamespace(handle)+"."+key);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_flash_init(){
+
+  mkdir(nvsDir().c_str(),0755);
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_flash_erase(){
+
+  DIR *dir=opendir(nvsDir().c_str());
+
+  if(!dir)
+    return(ESP_OK);
+
+  while(struct dirent *entry=readdir(dir)){
+    if(entry->d_name[0]!='.')
+      unlink((nvsDir()+"/"+entry->d_name).c_str());
+  }
+
+  closedir(dir);
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_open(const char *name, nvs_open_mode mode, nvs_handle *handle){
+
+  namespaces.push_back(name);
+  *handle=namespaces.size();
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+void nvs_close(nvs_handle handle){}
+
+//////////////////////////////////////
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *value, size_t *length){
+
+  if(!findNamespace(handle))
+    return(ESP_ERR_NVS_INVALID_HANDLE);
+
+  FILE *fp=fopen(blobPath(handle,key).c_str(),"rb");
+
+  if(!fp)
+    return(ESP_ERR_NVS_NOT_FOUND);
+
+  fseek(fp,0,SEEK_END);
+  size_t size=ftell(fp);
+  
+  if(value){
+    if(*length<size){
+      fclose(fp);
+      return(ESP_ERR_NVS_INVALID_LENGTH);
+    }
+    rewind(fp);
+    size=fread(value,1,size,fp);
+  }
+
+  fclose(fp);
+  *length=size;
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length){
+
+  if(!findNamespace(handle))
+    return(ESP_ERR_NVS_INVALID_HANDLE);
+
+  std::string path=blobPath(handle,key);
+  std::string tmpPath=path+".tmp";
+
+  FILE *fp=fopen(tmpPath.c_str(),"wb");
+
+  if(!fp || fwrite(value,1,length,fp)!=length || fclose(fp)){
+    Serial.printf("\n*** ERROR: Can't write NVS file %s\n\n",path.c_str());
+    return(ESP_FAIL);
+  }
+
+  rename(tmpPath.c_str(),path.c_str());           // replace blob atomically, as NVS does on the ESP32
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_erase_all(nvs_handle handle){
+
+  std::string *name=findNamespace(handle);
+
+  if(!name)
+    return(ESP_ERR_NVS_INVALID_HANDLE);
+
+  std::string prefix=*name+".";
+  DIR *dir=opendir(nvsDir().c_str());
+
+  if(!dir)
+    return(ESP_OK);
+
+  while(struct dirent *entry=readdir(dir)){
+    if(!strncmp(entry->d_name,prefix.c_str(),prefix.length()))
+      unlink((nvsDir()+"/"+entry->d_name).c_str());
+  }
+
+  closedir(dir);
+  return(ESP_OK);
+}
+
+//////////////////////////////////////
+
+esp_err_t nvs_commit(nvs_handle handle){
+  return(findNamespace(handle)?ESP_OK:ESP_ERR_NVS_INVALID_HANDLE);
+}
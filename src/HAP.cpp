@@ -108,17 +108,6 @@ void HAPClient::init(){
   homeSpan.hostName=(char *)malloc(nChars+1);
   sprintf(homeSpan.hostName,"%s-%2.2s%2.2s%2.2s%2.2s%2.2s%2.2s",homeSpan.hostNameBase,accessory.ID,accessory.ID+3,accessory.ID+6,accessory.ID+9,accessory.ID+12,accessory.ID+15);
 
-  tlv8.create(kTLVType_State,1,"STATE");                 // define the actual TLV records needed for the implementation of HAP; one for each kTLVType needed (HAP Table 5-6)
-  tlv8.create(kTLVType_PublicKey,384,"PUBKEY");
-  tlv8.create(kTLVType_Method,1,"METHOD");
-  tlv8.create(kTLVType_Salt,16,"SALT");
-  tlv8.create(kTLVType_Error,1,"ERROR");
-  tlv8.create(kTLVType_Proof,64,"PROOF");
-  tlv8.create(kTLVType_EncryptedData,1024,"ENC.DATA");
-  tlv8.create(kTLVType_Signature,64,"SIGNATURE");
-  tlv8.create(kTLVType_Identifier,64,"IDENTIFIER");
-  tlv8.create(kTLVType_Permissions,1,"PERMISSION");
-
   if(!nvs_get_blob(hapNVS,"HAPHASH",NULL,&len)){                 // if found HAP HASH structure
     nvs_get_blob(hapNVS,"HAPHASH",&homeSpan.hapConfig,&len);     // retrieve data    
   } else {
@@ -130,11 +119,13 @@ void HAPClient::init(){
   Serial.print("\n");
 
   uint8_t tHash[48];
-  TempBuffer <char> tBuf(homeSpan.sprintfAttributes(NULL)+1);
-  homeSpan.sprintfAttributes(tBuf.buf);  
-  mbedtls_sha512_ret((uint8_t *)tBuf.buf,tBuf.len(),tHash,1);     // create SHA-384 hash of JSON (can be any hash - just looking for a unique key)
+  JsonWriter json(4096);
+  homeSpan.writeAttributes(json);
+  mbedtls_sha512_ret((uint8_t *)json.buf,json.len+1,tHash,1);     // create SHA-384 hash of JSON, including null terminator (can be any hash - just looking for a unique key)
 
-  if(memcmp(tHash,homeSpan.hapConfig.hashCode,48)){           // if hash code of current HAP database does not match stored hash code
+  if(json.overflow){                                          // incomplete database would give the wrong hash
+    Serial.print("*** ERROR: Can't create Attributes database - configuration number not checked\n\n");
+  } else if(memcmp(tHash,homeSpan.hapConfig.hashCode,48)){    // if hash code of current HAP database does not match stored hash code
     memcpy(homeSpan.hapConfig.hashCode,tHash,48);             // update stored hash code
     homeSpan.hapConfig.configNumber++;                        // increment configuration number
     if(homeSpan.hapConfig.configNumber==65536)                // reached max value
@@ -165,17 +156,14 @@ void HAPClient::init(){
 
 void HAPClient::processRequest(){
 
-  int nBytes;
-  
   if(cPair){                           // expecting encrypted message
     LOG2("<<<< #### ");
     LOG2(client.remoteIP());
     LOG2(" #### <<<<\n");
 
-    nBytes=receiveEncrypted();           // decrypt and return number of bytes       
-        
-    if(!nBytes){                        // decryption failed (error message already printed in function)
+    if(receiveEncrypted()<0){           // decrypt all available frames into reqBuf (error message already printed in function)
       badRequestError();              
+      clearRequest();
       return;          
     }
         
@@ -183,40 +171,144 @@ void HAPClient::processRequest(){
     LOG2("<<<<<<<<< ");
     LOG2(client.remoteIP());
     LOG2(" <<<<<<<<<\n");
+
+    int nBytes=client.available();
     
-    nBytes=client.read(httpBuf,MAX_HTTP+1);   // read all available bytes up to maximum allowed+1
-       
-    if(nBytes>MAX_HTTP){                              // exceeded maximum number of bytes allowed
+    if(reqLen+nBytes>MAX_HTTP){                       // exceeded maximum number of bytes allowed
       badRequestError();
+      clearRequest();
       Serial.print("\n*** ERROR:  Exceeded maximum HTTP message length\n\n");
       return;
     }
+
+    uint8_t *reqEnd=reserveRequest(nBytes);
+    
+    if(!reqEnd){                                      // can't make room for request (error message already printed in function)
+      client.stop();
+      return;
+    }
+
+    nBytes=client.read(reqEnd,nBytes);                  // read all available bytes directly into end of reqBuf
+    if(nBytes>0)
+      reqLen+=nBytes;
         
   } // encrypted/plaintext
-      
-  httpBuf[nBytes]='\0';         // add null character to enable string functions
-      
-  char *body=(char *)httpBuf;   // char pointer to start of HTTP Body
-  char *p;                          // char pointer used for searches
-      
-  if(!(p=strstr((char *)httpBuf,"\r\n\r\n"))){
+
+  int status;
+
+  while((status=parseRequest())==1){                      // process each complete request in reqBuf
+
+    int totalLen=reqHeaderLen+reqContentLen;
+    uint8_t nextByte=reqBuf[totalLen];                    // save first byte of any subsequent request, since it will be overwritten by a trailing null
+
+    dispatchRequest((char *)reqBuf,reqBuf+reqHeaderLen,reqContentLen);
+
+    if(!client || (totalLen==reqLen && !rxAADLen)){       // client disconnected, or no more bytes in reqBuf and no partially-received frame
+      clearRequest();
+      return;
+    }
+    
+    reqBuf[totalLen]=nextByte;
+    reqLen-=totalLen;
+    memmove(reqBuf,reqBuf+totalLen,reqLen+rxGot);         // shift remaining bytes, including any partially-received encrypted frame that follows them, to start of reqBuf
+    reqScan=0;
+    reqHeaderLen=0;
+  }
+
+  if(status==-1){
     badRequestError();
-    Serial.print("\n*** ERROR:  Malformed HTTP request (can't find blank line indicating end of BODY)\n\n");
-    return;      
+    clearRequest();
   }
 
-  *p='\0';                            // null-terminate end of HTTP Body to faciliate additional string processing
-  uint8_t *content=(uint8_t *)p+4;    // byte pointer to start of optional HTTP Content
-  int cLen=0;                         // length of optional HTTP Content
+} // processRequest
 
-  if((p=strstr(body,"Content-Length: ")))       // Content-Length is specified
-    cLen=atoi(p+16);
-  if(nBytes!=strlen(body)+4+cLen){
-    badRequestError();
-    Serial.print("\n*** ERROR:  Malformed HTTP request (Content-Length plus Body Length does not equal total number of bytes read)\n\n");
-    return;        
+//////////////////////////////////////
+
+int HAPClient::parseRequest(){
+
+  if(!reqHeaderLen){                                      // still looking for blank line that ends HTTP header
+
+    for(;reqScan+3<reqLen;reqScan++){                     // resume search where previous call left off
+      if(!memcmp(reqBuf+reqScan,"\r\n\r\n",4))
+        break;
+    }
+
+    if(reqScan+3>=reqLen)                                 // blank line not yet received
+      return(0);
+
+    reqHeaderLen=reqScan+4;
+    reqBuf[reqScan]='\0';                                 // null-terminate end of HTTP header to faciliate additional string processing
+    reqContentLen=0;
+    reqContentType=contentType_None;
+
+    for(char *p=strchr((char *)reqBuf,'\n');p;p=strchr(p,'\n')){     // parse all header lines following request line in a single pass
+      p++;
+      if(!strncasecmp(p,"Content-Length:",15)){
+        reqContentLen=atoi(p+15);
+      } else
+      if(!strncasecmp(p,"Content-Type:",13)){
+        p+=13;
+        while(*p==' ')
+          p++;
+        if(!strncmp(p,"application/pairing+tlv8",24))
+          reqContentType=contentType_TLV8;
+        else if(!strncmp(p,"application/hap+json",20))
+          reqContentType=contentType_JSON;
+      }
+    }
+
+    if(reqContentLen<0 || reqHeaderLen+reqContentLen>MAX_HTTP){
+      Serial.print("\n*** ERROR:  Malformed HTTP request (invalid Content-Length)\n\n");
+      return(-1);
+    }
+  }
+
+  if(reqLen<reqHeaderLen+reqContentLen)                   // Content not yet fully received
+    return(0);
+
+  return(1);
+  
+} // parseRequest
+
+//////////////////////////////////////
+
+uint8_t *HAPClient::reserveRequest(int nBytes){
+
+  if(reqLen+nBytes+1>reqCap){                             // need more room (+1 to leave room for trailing null)
+    int newCap=reqCap?reqCap*2:512;
+    if(newCap<reqLen+nBytes+1)
+      newCap=reqLen+nBytes+1;
+    uint8_t *newBuf=(uint8_t *)realloc(reqBuf,newCap);
+    if(!newBuf){                                          // can't allocate more room - discard request
+      Serial.print("\n*** ERROR:  Can't allocate memory for HTTP request\n\n");
+      clearRequest();
+      return(NULL);
+    }
+    reqBuf=newBuf;
+    reqCap=newCap;
   }
 
+  return(reqBuf+reqLen);
+}
+
+//////////////////////////////////////
+
+void HAPClient::clearRequest(){
+
+  free(reqBuf);
+  reqBuf=NULL;
+  reqLen=0;
+  reqCap=0;
+  reqScan=0;
+  reqHeaderLen=0;
+  rxAADLen=0;
+  rxGot=0;
+}
+
+//////////////////////////////////////
+
+void HAPClient::dispatchRequest(char *body, uint8_t *content, int cLen){
+
   LOG2(body);
   LOG2("\n------------ END BODY! ------------\n");
 
@@ -229,7 +321,7 @@ void HAPClient::processRequest(){
     }
            
     if(!strncmp(body,"POST /pair-setup ",17) &&                              // POST PAIR-SETUP
-       strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
+       reqContentType==contentType_TLV8 &&                                   // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
        if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
@@ -239,7 +331,7 @@ void HAPClient::processRequest(){
     }
 
     if(!strncmp(body,"POST /pair-verify ",18) &&                             // POST PAIR-VERIFY
-       strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
+       reqContentType==contentType_TLV8 &&                                   // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
        if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
@@ -249,17 +341,7 @@ void HAPClient::processRequest(){
     }
             
     if(!strncmp(body,"POST /pairings ",15) &&                                // POST PAIRINGS
-       strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
-       tlv8.unpack(content,cLen)){                                          // read TLV content
-       if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
-      LOG2("------------ END TLVS! ------------\n");
-               
-      postPairingsURL();                  // process URL    
-      return;
-    }
-
-    if(!strncmp(body,"POST /pairings ",15) &&                                // POST PAIRINGS
-       strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
+       reqContentType==contentType_TLV8 &&                                   // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
        if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
@@ -283,7 +365,7 @@ void HAPClient::processRequest(){
     }
            
     if(!strncmp(body,"PUT /characteristics ",21) &&                          // PUT CHARACTERISTICS
-       strstr(body,"Content-Type: application/hap+json")){                   // check that content is JSON
+       reqContentType==contentType_JSON){                                    // check that content is JSON
 
       content[cLen]='\0';                                                    // add a trailing null on end of JSON
       LOG2((char *)content);                                         // print JSON
@@ -294,7 +376,7 @@ void HAPClient::processRequest(){
     }
 
     if(!strncmp(body,"PUT /prepare ",13) &&                          // PUT PREPARE
-       strstr(body,"Content-Type: application/hap+json")){                   // check that content is JSON
+       reqContentType==contentType_JSON){                                    // check that content is JSON
 
       content[cLen]='\0';                                                    // add a trailing null on end of JSON
       LOG2((char *)content);                                         // print JSON
@@ -331,7 +413,7 @@ void HAPClient::processRequest(){
   badRequestError();
   Serial.print("\n*** ERROR:  Unknown or malformed HTTP request\n\n");
                         
-} // processHAP
+} // dispatchRequest
 
 //////////////////////////////////////
 
@@ -389,6 +471,20 @@ int HAPClient::unauthorizedError(){
 
 //////////////////////////////////////
 
+int HAPClient::resourceError(){
+
+  char s[]="HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+  LOG2("\n>>>>>>>>>> ");
+  LOG2(client.remoteIP());
+  LOG2(" >>>>>>>>>>\n");
+  LOG2(s);
+  sendEncrypted(s,NULL,0);              // connection is kept open so the Controller can retry once memory is available
+
+  return(-1);
+}
+
+//////////////////////////////////////
+
 int HAPClient::postPairSetupURL(){
 
   LOG1("In Pair Setup...");
@@ -411,9 +507,36 @@ int HAPClient::postPairSetupURL(){
     return(0);
   };
 
+  if(pairSetupClient!=conNum || pairSetupID!=connectionID){        // this connection does not own the Pair-Setup exchange
+    if(pairSetupClient>=0 && hap[pairSetupClient]->client &&          // error: another connected client is in the middle of Pair-Setup
+       hap[pairSetupClient]->connectionID==pairSetupID && (pairStatus!=pairState_M1 || srpBusy())){
+      Serial.print("\n*** ERROR: Pair-Setup in progress on another connection!\n\n");
+      tlv8.clear();                                         // clear TLV records
+      tlv8.val(kTLVType_State,tlvState+1);                  // set response STATE to requested state+1 (which should match the state that was expected by the controller)
+      tlv8.val(kTLVType_Error,tagError_Busy);              // set Error=Busy
+      tlvRespond();                                       // send response to client
+      return(0);
+    }
+    pairSetupClient=conNum;                               // take ownership of Pair-Setup
+    pairSetupID=connectionID;
+    if(!srpBusy())
+      pairStatus=pairState_M1;                            // restart pair-setup from first step (which may be needed if prior owner failed in middle of pair-setup)
+  }
+
+  pairSetupTime=millis();                                 // restart inactivity timer of owner
+
   sprintf(buf,"Found <M%d>.  Expected <M%d>\n",tlvState,pairStatus);
   LOG2(buf);
 
+  if(srpBusy()){                                        // error: SRP calculation for a prior step is still running (or waiting to be sent)
+    Serial.print("\n*** ERROR: Pair-Setup busy!\n\n");
+    tlv8.clear();                                         // clear TLV records
+    tlv8.val(kTLVType_State,tlvState+1);                  // set response STATE to requested state+1 (which should match the state that was expected by the controller)
+    tlv8.val(kTLVType_Error,tagError_Busy);              // set Error=Busy
+    tlvRespond();                                       // send response to client
+    return(0);
+  }
+
   if(tlvState!=pairStatus){                             // error: Device is not yet paired, but out-of-sequence pair-setup STATE was received
     Serial.print("\n*** ERROR: Out-of-Sequence Pair-Setup request!\n\n");
     tlv8.clear();                                         // clear TLV records
@@ -424,6 +547,8 @@ int HAPClient::postPairSetupURL(){
     return(0);
   };
    
+  srpStart=millis();
+
   switch(tlvState){          // valid and in-sequence Pair-Setup STATE received -- process request!  (HAP Section 5.6)
 
     case pairState_M1:                     // 'SRP Start Request'
@@ -437,14 +562,19 @@ int HAPClient::postPairSetupURL(){
         return(0);
       };
 
-      tlv8.clear();
-      tlv8.val(kTLVType_State,pairState_M2);            // set State=<M2>
-      srp.createPublicKey();                          // create accessory public key from random Pair-Setup code (displayed to user)
-      srp.loadTLV(kTLVType_PublicKey,&srp.B);         // load server public key, B
-      srp.loadTLV(kTLVType_Salt,&srp.s);              // load salt, s
-      tlvRespond();                                   // send response to client
-
-      pairStatus=pairState_M3;                        // set next expected pair-state request from client
+      if(srp.keysReady){                              // public key was precomputed
+        LOG1("Using precomputed public key...\n");
+        srp.createPublicKey();                        // load accessory public key
+        pairSetupM2();                                // send response
+      } else if(srpStatus==srpRunning){               // public key is being precomputed by worker task
+        LOG1("Waiting for public key being precomputed in background...\n");
+        srpClient=conNum;                             // claim calculation - response will be sent from checkSRP()
+        srpID=connectionID;
+      } else {
+        LOG1("Computing public key in background...\n");
+        startSRP(pairState_M1);                       // create accessory public key in worker task - response will be sent from checkSRP()
+      }
+      
       return(1);
       
     break;
@@ -463,25 +593,8 @@ int HAPClient::postPairSetupURL(){
         return(0);
       };
 
-      srp.createSessionKey();                               // create session key, K, from receipt of HAP Client public key, A
-
-      if(!srp.verifyProof()){                               // verify proof, M1, received from HAP Client
-        Serial.print("\n*** ERROR: SRP Proof Verification Failed\n\n");
-        tlv8.clear();                                         // clear TLV records
-        tlv8.val(kTLVType_State,pairState_M4);                // set State=<M4>
-        tlv8.val(kTLVType_Error,tagError_Authentication);    // set Error=Authentication
-        tlvRespond();                                       // send response to client
-        pairStatus=pairState_M1;                            // reset pairStatus to first step of unpaired
-        return(0);        
-      };
-
-      srp.createProof();                                  // M1 has been successully verified; now create accessory proof M2
-      tlv8.clear();                                         // clear TLV records
-      tlv8.val(kTLVType_State,pairState_M4);                // set State=<M4>
-      srp.loadTLV(kTLVType_Proof,&srp.M2);                // load M2 counter-proof
-      tlvRespond();                                       // send response to client
-
-      pairStatus=pairState_M5;                            // set next expected pair-state request from client
+      LOG1("Computing session key in background...\n");
+      startSRP(pairState_M3);                               // create session key, K, from receipt of HAP Client public key, A, and verify proof, M1, in worker task - response will be sent from checkSRP()
       return(1);        
         
     break;
@@ -636,6 +749,13 @@ int HAPClient::postPairSetupURL(){
       
       tlvRespond();                        // send response to client
 
+      sprintf(buf,"Pair-Setup <M5> completed in %lu ms\n",millis()-srpStart);
+      LOG1(buf);
+
+      pairSetupClient=-1;                  // Pair-Setup complete - release ownership
+      pairSetupID=0;
+      pairStatus=pairState_M1;
+
       mdns_service_txt_item_set("_hap","_tcp","sf","0");           // broadcast new status
       
       LOG1("\n*** ACCESSORY PAIRED! ***\n");
@@ -651,6 +771,52 @@ int HAPClient::postPairSetupURL(){
 
 //////////////////////////////////////
 
+void HAPClient::pairSetupM2(){
+
+  char buf[64];
+
+  tlv8.clear();
+  tlv8.val(kTLVType_State,pairState_M2);            // set State=<M2>
+  srp.loadTLV(kTLVType_PublicKey,&srp.B);         // load server public key, B
+  srp.loadTLV(kTLVType_Salt,&srp.s);              // load salt, s
+  tlvRespond();                                   // send response to client
+
+  sprintf(buf,"Pair-Setup <M1> completed in %lu ms\n",millis()-srpStart);
+  LOG1(buf);
+
+  pairStatus=pairState_M3;                        // set next expected pair-state request from client
+}
+
+//////////////////////////////////////
+
+void HAPClient::pairSetupM4(){
+
+  char buf[64];
+
+  if(!srpVerified){                                     // proof, M1, received from HAP Client could not be verified
+    Serial.print("\n*** ERROR: SRP Proof Verification Failed\n\n");
+    tlv8.clear();                                         // clear TLV records
+    tlv8.val(kTLVType_State,pairState_M4);                // set State=<M4>
+    tlv8.val(kTLVType_Error,tagError_Authentication);    // set Error=Authentication
+    tlvRespond();                                       // send response to client
+    pairStatus=pairState_M1;                            // reset pairStatus to first step of unpaired
+    return;
+  };
+
+  srp.createProof();                                  // M1 has been successully verified; now create accessory proof M2
+  tlv8.clear();                                         // clear TLV records
+  tlv8.val(kTLVType_State,pairState_M4);                // set State=<M4>
+  srp.loadTLV(kTLVType_Proof,&srp.M2);                // load M2 counter-proof
+  tlvRespond();                                       // send response to client
+
+  sprintf(buf,"Pair-Setup <M3> completed in %lu ms\n",millis()-srpStart);
+  LOG1(buf);
+
+  pairStatus=pairState_M5;                            // set next expected pair-state request from client
+}
+
+//////////////////////////////////////
+
 int HAPClient::postPairVerifyURL(){
 
   LOG2("In Pair Verify #");
@@ -681,9 +847,14 @@ int HAPClient::postPairVerifyURL(){
   sprintf(buf,"Found <M%d>\n",tlvState);                 // unlike pair-setup, out-of-sequencing can be handled gracefully for pair-verify (HAP requirement). No need to keep track of pairStatus
   LOG2(buf);
 
+  unsigned long verifyStart=micros();
+
   switch(tlvState){          // Pair-Verify STATE received -- process request!  (HAP Section 5.7)
 
-    case pairState_M1:                     // 'Verify Start Request'
+    case pairState_M1:                     // 'Verify Start Request' (or 'Resume Request' if Method=6)
+
+      if(tlv8.val(kTLVType_Method)==6 && pairResume())      // session was resumed (response already sent)
+        return(1);
 
       if(!tlv8.buf(kTLVType_PublicKey)){            
         Serial.print("\n*** ERROR: Required 'PublicKey' TLV record for this step is bad or missing\n\n");
@@ -744,6 +915,7 @@ int HAPClient::postPairVerifyURL(){
         memcpy(tlv8.buf(kTLVType_PublicKey,32),publicCurveKey,32);        // set PublicKey to Accessory's Curve25519 public key
       
         tlvRespond();                        // send response to client
+        homeSpan.stats.verifyTime+=micros()-verifyStart;      // first half of full Pair-Verify
         return(1);        
       }
       
@@ -836,6 +1008,13 @@ int HAPClient::postPairVerifyURL(){
       a2cNonce.zero();         // reset Nonces for this session to zero
       c2aNonce.zero();
 
+      uint8_t sessionID[32];
+      hkdf.create(sessionID,sharedCurveKey,32,"Pair-Verify-ResumeSessionID-Salt","Pair-Verify-ResumeSessionID-Info");    // derive Session ID (first 8 bytes) that Controller can use to resume this session
+      saveResumeSession(cPair,sessionID,sharedCurveKey);
+
+      homeSpan.stats.nVerify++;
+      homeSpan.stats.tally(homeSpan.stats.verifyTime,homeSpan.stats.maxVerifyTime,verifyStart);     // second half of full Pair-Verify
+
       LOG2("\n*** SESSION VERIFICATION COMPLETE *** \n");
       return(1);
 
@@ -847,6 +1026,67 @@ int HAPClient::postPairVerifyURL(){
 
 //////////////////////////////////////
 
+int HAPClient::pairResume(){
+
+  unsigned long resumeStart=micros();
+  ResumeSession *rs;
+
+  if(tlv8.len(kTLVType_PublicKey)!=32 || tlv8.len(kTLVType_SessionID)!=8 || tlv8.len(kTLVType_EncryptedData)!=16 || !(rs=findResumeSession(tlv8.buf(kTLVType_SessionID)))){
+    LOG2("Resume Session not found - performing full Pair-Verify\n");
+    homeSpan.stats.nResumeMisses++;
+    return(0);
+  }
+
+  uint8_t salt[32+8];                         // salt = Controller's new Curve25519 public key + Session ID
+  uint8_t resumeKey[32];
+
+  memcpy(salt,tlv8.buf(kTLVType_PublicKey),32);
+  memcpy(salt+32,rs->ID,8);
+  hkdf.create(resumeKey,rs->sharedSecret,32,salt,sizeof(salt),"Pair-Resume-Request-Info");
+
+  if(crypto_aead_chacha20poly1305_ietf_decrypt(NULL,NULL,NULL,tlv8.buf(kTLVType_EncryptedData),16,NULL,0,(unsigned char *)"\x00\x00\x00\x00PR-Msg01",resumeKey)==-1){     // EncryptedData is just the authentication tag of an empty message
+    LOG2("Resume Request Authentication Failed - performing full Pair-Verify\n");
+    rs->controller=NULL;                      // sessions can only be resumed once - discard
+    homeSpan.stats.nResumeMisses++;
+    return(0);
+  }
+
+  Controller *tPair=rs->controller;
+  
+  randombytes_buf(rs->ID,8);                  // replace Session ID so the resumed session can itself be resumed later
+  memcpy(salt+32,rs->ID,8);
+  hkdf.create(resumeKey,rs->sharedSecret,32,salt,sizeof(salt),"Pair-Resume-Response-Info");
+  hkdf.create(sharedCurveKey,rs->sharedSecret,32,salt,sizeof(salt),"Pair-Resume-Shared-Secret-Info");      // Shared Secret of resumed session
+  memcpy(rs->sharedSecret,sharedCurveKey,32);
+  rs->lastUsed=++resumeCount;
+
+  unsigned long long edLen;
+
+  tlv8.clear();                                         // clear TLV records
+  tlv8.val(kTLVType_State,pairState_M2);                // set State=<M2>
+  memcpy(tlv8.buf(kTLVType_SessionID,8),rs->ID,8);      // set new Session ID
+  crypto_aead_chacha20poly1305_ietf_encrypt(tlv8.buf(kTLVType_EncryptedData),&edLen,NULL,0,NULL,0,NULL,(unsigned char *)"\x00\x00\x00\x00PR-Msg02",resumeKey);
+  tlv8.buf(kTLVType_EncryptedData,edLen);              // set length of EncryptedData TLV record (authentication tag only)
+  
+  tlvRespond();                                       // send response to client (unencrypted since cPair=NULL)
+
+  cPair=tPair;        // save Controller for this connection slot - connection is now verified and should be encrypted going forward
+
+  hkdf.create(a2cKey,sharedCurveKey,32,"Control-Salt","Control-Read-Encryption-Key");        // create AccessoryToControllerKey (HAP Section 6.5.2)
+  hkdf.create(c2aKey,sharedCurveKey,32,"Control-Salt","Control-Write-Encryption-Key");       // create ControllerToAccessoryKey (HAP Section 6.5.2)
+  
+  a2cNonce.zero();         // reset Nonces for this session to zero
+  c2aNonce.zero();
+
+  homeSpan.stats.nResumes++;
+  homeSpan.stats.tally(homeSpan.stats.resumeTime,homeSpan.stats.maxResumeTime,resumeStart);
+
+  LOG2("\n*** SESSION RESUMED *** \n");
+  return(1);
+}
+
+//////////////////////////////////////
+
 int HAPClient::getAccessoriesURL(){
 
   if(!cPair){                       // unverified, unencrypted session
@@ -860,22 +1100,23 @@ int HAPClient::getAccessoriesURL(){
   LOG1(client.remoteIP());
   LOG1(")...\n");
 
-  int nBytes = homeSpan.sprintfAttributes(NULL);        // get size of HAP attributes JSON
-  TempBuffer <char> jBuf(nBytes+1);
-  homeSpan.sprintfAttributes(jBuf.buf);                  // create JSON database (will need to re-cast to uint8_t* below)
+  JsonWriter json(4096);
+  homeSpan.writeAttributes(json);                        // create JSON database (will need to re-cast to uint8_t* below)
 
-  int nChars=snprintf(NULL,0,"HTTP/1.1 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);      // create '200 OK' Body with Content Length = size of JSON Buf
-  char body[nChars+1];
-  sprintf(body,"HTTP/1.1 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);
+  if(json.overflow)
+    return(resourceError());
+
+  char body[128];
+  sprintf(body,"HTTP/1.1 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",json.len);      // create '200 OK' Body with Content Length = size of JSON
   
   LOG2("\n>>>>>>>>>> ");
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");
   LOG2(body);
-  LOG2(jBuf.buf);
+  LOG2(json.buf);
   LOG2("\n");
   
-  sendEncrypted(body,(uint8_t *)jBuf.buf,nBytes);
+  sendEncrypted(body,(uint8_t *)json.buf,json.len);
        
   return(1);
   
@@ -1076,24 +1317,23 @@ int HAPClient::getCharacteristicsURL(char *urlBuf){
   if(!numIDs)           // could not find any IDs
     return(0);
 
-  int nBytes=homeSpan.sprintfAttributes(ids,numIDs,flags,NULL);          // get JSON response - includes terminating null (will be recast to uint8_t* below)
-  char jsonBuf[nBytes+1];
-  homeSpan.sprintfAttributes(ids,numIDs,flags,jsonBuf);
+  JsonWriter json;
+  boolean sFlag=homeSpan.writeAttributes(ids,numIDs,flags,json);          // get JSON response (will be recast to uint8_t* below) and note whether status attributes were included
 
-  boolean sFlag=strstr(jsonBuf,"status");          // status attribute found?
+  if(json.overflow)
+    return(resourceError());
 
-  int nChars=snprintf(NULL,0,"HTTP/1.1 %s\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",!sFlag?"200 OK":"207 Multi-Status",nBytes);   
-  char body[nChars+1];    
-  sprintf(body,"HTTP/1.1 %s\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",!sFlag?"200 OK":"207 Multi-Status",nBytes);
+  char body[128];    
+  sprintf(body,"HTTP/1.1 %s\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",!sFlag?"200 OK":"207 Multi-Status",json.len);
     
   LOG2("\n>>>>>>>>>> ");
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");    
   LOG2(body);
-  LOG2(jsonBuf);
+  LOG2(json.buf);
   LOG2("\n");
   
-  sendEncrypted(body,(uint8_t *)jsonBuf,nBytes);        // note recasting of jsonBuf into uint8_t*
+  sendEncrypted(body,(uint8_t *)json.buf,json.len);        // note recasting of json.buf into uint8_t*
       
   return(1);
 }
@@ -1113,12 +1353,13 @@ int HAPClient::putCharacteristicsURL(char *json){
   LOG1(client.remoteIP());
   LOG1(")...\n");
 
-  int n=homeSpan.countCharacteristics(json);    // count number of objects in JSON request
+  int n=homeSpan.countCharacteristics(json);    // get upper bound on number of objects in JSON request
   if(n==0)                                      // if no objects found, return
     return(0);
  
-  SpanBuf pObj[n];                                        // reserve space for objects
-  if(!homeSpan.updateCharacteristics(json, pObj))         // perform update
+  vector<SpanBuf> objBuf(n);                              // reserve space for objects on heap (n may be as large as the number of Characteristics)
+  SpanBuf *pObj=objBuf.data();
+  if(!(n=homeSpan.updateCharacteristics(json,pObj,n)))    // perform update and save actual number of objects
     return(0);                                            // return if failed to update (error message will have been printed in update)
 
   int multiCast=0;                                        // check if all status is OK, or if multicast response is request
@@ -1139,23 +1380,24 @@ int HAPClient::putCharacteristicsURL(char *json){
         
   } else {                                                       // multicast respose is required
 
-    int nBytes=homeSpan.sprintfAttributes(pObj,n,NULL);          // get JSON response - includes terminating null (will be recast to uint8_t* below)
-    char jsonBuf[nBytes+1];
-    homeSpan.sprintfAttributes(pObj,n,jsonBuf);
+    JsonWriter json;
+    homeSpan.writeAttributes(pObj,n,json);                       // get JSON response (will be recast to uint8_t* below)
 
-    int nChars=snprintf(NULL,0,"HTTP/1.1 207 Multi-Status\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);      // create Body with Content Length = size of JSON Buf
-    char body[nChars+1];
-    sprintf(body,"HTTP/1.1 207 Multi-Status\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);
+    if(json.overflow){                                           // Characteristics were still updated, so fall through to Event Notifications below
+      resourceError();
+    } else {
+      char body[128];
+      sprintf(body,"HTTP/1.1 207 Multi-Status\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",json.len);      // create Body with Content Length = size of JSON
   
-    LOG2("\n>>>>>>>>>> ");
-    LOG2(client.remoteIP());
-    LOG2(" >>>>>>>>>>\n");    
-    LOG2(body);
-    LOG2(jsonBuf);
-    LOG2("\n");
-  
-    sendEncrypted(body,(uint8_t *)jsonBuf,nBytes);        // note recasting of jsonBuf into uint8_t*
+      LOG2("\n>>>>>>>>>> ");
+      LOG2(client.remoteIP());
+      LOG2(" >>>>>>>>>>\n");    
+      LOG2(body);
+      LOG2(json.buf);
+      LOG2("\n");
   
+      sendEncrypted(body,(uint8_t *)json.buf,json.len);        // note recasting of json.buf into uint8_t*
+    }
   }
 
   // Create and send Event Notifications if needed
@@ -1204,8 +1446,7 @@ int HAPClient::putPrepareURL(char *json){
 
   sprintf(jsonBuf,"{\"status\":%d}",status);
   int nBytes=strlen(jsonBuf);
-  int nChars=snprintf(NULL,0,"HTTP/1.1 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);      // create Body with Content Length = size of JSON Buf
-  char body[nChars+1];
+  char body[128];
   sprintf(body,"HTTP/1.1 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);
   
   LOG2("\n>>>>>>>>>> ");
@@ -1248,10 +1489,136 @@ void HAPClient::checkPushButtons(){
 
 void HAPClient::checkNotifications(){
 
-  if(!homeSpan.Notifications.empty()){                                          // if there are Notifications to process    
-    eventNotify(&homeSpan.Notifications[0],homeSpan.Notifications.size());      // transmit EVENT Notifications
-    homeSpan.Notifications.clear();                                             // clear Notifications vector
+  if(homeSpan.Notifications.empty())                                            // nothing to process
+    return;
+
+  unsigned long cTime=millis();
+  int nReady=0;
+  
+  for(int i=0;i<homeSpan.Notifications.size();i++){                             // move Notifications that are ready to be sent to front of vector
+    SpanCharacteristic *c=homeSpan.Notifications[i].characteristic;
+    if(!c->notifyInterval || (c->perms&SpanCharacteristic::NV) || cTime-c->notifyTime>=c->notifyInterval){
+      std::swap(homeSpan.Notifications[nReady],homeSpan.Notifications[i]);
+      nReady++;
+    }
+  }
+
+  if(!nReady)                                                                   // all Notifications are deferred until their notifyInterval elapses
+    return;
+    
+  eventNotify(&homeSpan.Notifications[0],nReady);                               // transmit EVENT Notifications
+
+  for(int i=0;i<nReady;i++){
+    homeSpan.Notifications[i].characteristic->notifyPending=false;
+    homeSpan.Notifications[i].characteristic->notifyTime=cTime;
+  }
+  
+  homeSpan.Notifications.erase(homeSpan.Notifications.begin(),homeSpan.Notifications.begin()+nReady);      // remove Notifications that were sent
+}
+
+//////////////////////////////////////
+
+void HAPClient::startSRP(pairState step){
+
+  if(!srpTaskHandle && xTaskCreatePinnedToCore(srpTask,"srpTask",8192,NULL,1,&srpTaskHandle,tskNO_AFFINITY)!=pdPASS){
+    Serial.print("*** ERROR: Can't create SRP task - performing calculation in poll()\n");
+    srpTaskHandle=NULL;
+  }
+
+  srpStep=step;
+  srpClient=conNum;
+  srpID=hap[conNum]->connectionID;
+  srpCalcStart=millis();
+  srpStatus=srpRunning;
+
+  if(srpTaskHandle)
+    xTaskNotifyGive(srpTaskHandle);       // wake worker task
+  else
+    srpCalculate();                       // no worker task - perform calculation now
+}
+
+//////////////////////////////////////
+
+void HAPClient::precomputeSRP(){
+
+  if(srp.keysReady || srpStatus!=srpIdle || pairStatus!=pairState_M1 || nAdminControllers())      // keys already available, worker task is busy, Pair-Setup is in progress, or device is paired
+    return;
+
+  if(!srpTaskHandle && xTaskCreatePinnedToCore(srpTask,"srpTask",8192,NULL,1,&srpTaskHandle,tskNO_AFFINITY)!=pdPASS){
+    srpTaskHandle=NULL;                   // no worker task - skip precomputation rather than block poll() (key will be computed when Pair-Setup <M1> is received)
+    return;
+  }
+
+  srpStep=pairState_M1;
+  srpClient=-1;                           // no connection is waiting for this result yet
+  srpID=0;
+  srpCalcStart=millis();
+  srpStatus=srpRunning;
+
+  xTaskNotifyGive(srpTaskHandle);         // wake worker task
+}
+
+//////////////////////////////////////
+
+void HAPClient::srpTask(void *arg){
+
+  for(;;){
+    ulTaskNotifyTake(pdTRUE,portMAX_DELAY);     // wait until there is something to calculate
+    srpCalculate();
+  }
+}
+
+//////////////////////////////////////
+
+void HAPClient::srpCalculate(){
+
+  if(srpStep==pairState_M1){
+    srp.precomputePublicKey();            // create random b and accessory public key, B (loaded by createPublicKey() when the response is sent)
+  } else {
+    srp.createSessionKey();               // create session key, K, from receipt of HAP Client public key, A
+    srpVerified=srp.verifyProof();        // verify proof, M1, received from HAP Client
+  }
+
+  srpStatus=srpDone;
+}
+
+//////////////////////////////////////
+
+void HAPClient::checkSRP(){
+
+  if(!srpBusy() && pairSetupClient>=0 && millis()-pairSetupTime>PAIR_SETUP_TIMEOUT){     // owner of Pair-Setup has been inactive too long - release Pair-Setup so other connections can pair
+    if(pairStatus!=pairState_M1)
+      Serial.print("\n*** ERROR: Pair-Setup timed out waiting for Controller\n\n");
+    pairSetupClient=-1;
+    pairSetupID=0;
+    pairStatus=pairState_M1;
+  }
+
+  if(srpStatus!=srpDone)
+    return;
+
+  if(srpClient<0){                                              // public key was precomputed with no connection waiting - it will be used by the next Pair-Setup <M1>
+    LOG1("Precomputed SRP public key for Pair-Setup (");
+    LOG1(millis()-srpCalcStart);
+    LOG1(" ms)\n");
+    srpStatus=srpIdle;
+    return;
+  }
+
+  if(srpID==pairSetupID && hap[srpClient]->client && hap[srpClient]->connectionID==srpID){     // connection that requested calculation still owns Pair-Setup and is still connected - send deferred response
+    conNum=srpClient;
+    pairSetupTime=millis();                                     // restart inactivity timer of owner
+    if(srpStep==pairState_M1){
+      srp.createPublicKey();                                    // load public key computed by worker task
+      hap[srpClient]->pairSetupM2();
+    } else {
+      hap[srpClient]->pairSetupM4();
+    }
+  } else {
+    pairStatus=pairState_M1;                                    // client disconnected (or slot was re-used by a new connection) while waiting - reset Pair-Setup
   }
+  
+  srpStatus=srpIdle;
 }
 
 //////////////////////////////////////
@@ -1275,28 +1642,47 @@ void  HAPClient::checkTimedWrites(){
 
 
 void HAPClient::eventNotify(SpanBuf *pObj, int nObj, int ignoreClient){
+
+  JsonWriter frags;                                           // holds JSON fragments for all updated characteristics, rendered once per batch
+  int offset[nObj+1];                                         // start of each fragment in frags
+  
+  homeSpan.writeFragments(pObj,nObj,frags,offset);
+
+  if(frags.overflow){
+    Serial.print("*** ERROR: Can't create Event Notifications - none sent\n\n");
+    return;
+  }
+
+  if(!frags.len)                                              // no characteristics were updated (i.e. only EV requests)
+    return;
+
+  JsonWriter json;                                            // re-used for each connection
   
   for(int cNum=0;cNum<homeSpan.maxConnections;cNum++){        // loop over all connection slots
-    if(hap[cNum]->client && cNum!=ignoreClient){       // if there is a client connected to this slot and it is NOT flagged to be ignored (in cases where it is the client making a PUT request)
+    if(hap[cNum]->client && cNum!=ignoreClient && !hap[cNum]->subscriptions.empty()){     // if there is a client connected to this slot that has subscribed to at least one characteristic, and it is NOT flagged to be ignored (in cases where it is the client making a PUT request)
+
+      json.clear();
 
-      int nBytes=homeSpan.sprintfNotify(pObj,nObj,NULL,cNum);          // get JSON response for notifications to client cNum - includes terminating null (will be recast to uint8_t* below)
+      if(homeSpan.writeNotify(pObj,nObj,frags,offset,json,cNum)){      // if there are notifications to send to client cNum (will be recast to uint8_t* below)
 
-      if(nBytes>0){                                                    // if there are notifications to send to client cNum
-        char jsonBuf[nBytes+1];
-        homeSpan.sprintfNotify(pObj,nObj,jsonBuf,cNum);
+        if(json.overflow){
+          Serial.print("*** ERROR: Can't create Event Notification for Client #");
+          Serial.print(cNum);
+          Serial.print(" - not sent\n\n");
+          continue;
+        }
 
-        int nChars=snprintf(NULL,0,"EVENT/1.0 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);      // create Body with Content Length = size of JSON Buf
-        char body[nChars+1];
-        sprintf(body,"EVENT/1.0 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",nBytes);
+        char body[128];
+        sprintf(body,"EVENT/1.0 200 OK\r\nContent-Type: application/hap+json\r\nContent-Length: %d\r\n\r\n",json.len);      // create Body with Content Length = size of JSON
 
         LOG2("\n>>>>>>>>>> ");
         LOG2(hap[cNum]->client.remoteIP());
         LOG2(" >>>>>>>>>>\n");    
         LOG2(body);
-        LOG2(jsonBuf);
+        LOG2(json.buf);
         LOG2("\n");
   
-        hap[cNum]->sendEncrypted(body,(uint8_t *)jsonBuf,nBytes);        // note recasting of jsonBuf into uint8_t*
+        hap[cNum]->sendEncrypted(body,(uint8_t *)json.buf,json.len);        // note recasting of json.buf into uint8_t*
 
       } // if there are characteristic updates to notify client cNum
     } // if client exists
@@ -1309,13 +1695,10 @@ void HAPClient::eventNotify(SpanBuf *pObj, int nObj, int ignoreClient){
 
 void HAPClient::tlvRespond(){
 
-  int nBytes=tlv8.pack(NULL);      // return number of bytes needed to pack TLV records into a buffer
-  uint8_t tlvData[nBytes];         // create buffer
-  tlv8.pack(tlvData);              // pack TLV records into buffer
+  int nBytes=tlv8.pack(NULL);      // return number of bytes needed to pack TLV records (TLV records are packed directly into the output as it is sent)
 
-  int nChars=snprintf(NULL,0,"HTTP/1.1 200 OK\r\nContent-Type: application/pairing+tlv8\r\nContent-Length: %d\r\n\r\n",nBytes);      // create Body with Content Length = size of TLV data
-  char body[nChars+1];
-  sprintf(body,"HTTP/1.1 200 OK\r\nContent-Type: application/pairing+tlv8\r\nContent-Length: %d\r\n\r\n",nBytes);
+  char body[96];
+  sprintf(body,"HTTP/1.1 200 OK\r\nContent-Type: application/pairing+tlv8\r\nContent-Length: %d\r\n\r\n",nBytes);      // create Body with Content Length = size of TLV data
   
   LOG2("\n>>>>>>>>>> ");
   LOG2(client.remoteIP());
@@ -1324,11 +1707,16 @@ void HAPClient::tlvRespond(){
   if(homeSpan.logLevel>1) tlv8.print();
 
   if(!cPair){                       // unverified, unencrypted session
-    client.print(body);
-    client.write(tlvData,nBytes);      
+    int msgLen=strlen(body)+nBytes;
+    TempBuffer <uint8_t> txBuf(msgLen<1024?msgLen:1024);      // transmit buffer for Body followed by packed TLV records
+    for(int i=0;i<msgLen;i+=txBuf.len()){
+      int n=msgLen-i<txBuf.len()?msgLen-i:txBuf.len();
+      copyMessage(txBuf.buf,body,NULL,i,n);
+      client.write(txBuf.buf,n);
+    }
     LOG2("------------ SENT! --------------\n");
   } else {
-    sendEncrypted(body,tlvData,nBytes);
+    sendEncrypted(body,NULL,nBytes);
   }
 
 } // tlvRespond
@@ -1337,32 +1725,49 @@ void HAPClient::tlvRespond(){
 
 int HAPClient::receiveEncrypted(){
 
-  uint8_t buf[1042];               // maximum size of encoded message = 2+1024+16 bytes (HAP Section 6.5.2)
-  int nFrames=0;
   int nBytes=0;
+  int r;
 
-  while(client.read(buf,2)==2){    // read initial 2-byte AAD record
+  while(client.available()>0){          // frames may arrive split across any number of TCP segments, so read only what is available and resume on next call
+  
+    if(rxAADLen<2){                                               // still reading 2-byte AAD record of next frame
+      
+      if((r=client.read(rxAAD+rxAADLen,2-rxAADLen))<=0)
+        break;
+        
+      if((rxAADLen+=r)<2)
+        continue;
 
-    int n=buf[0]+buf[1]*256;                // compute number of bytes expected in encoded message
+      rxFrameLen=rxAAD[0]+rxAAD[1]*256;                           // compute number of bytes expected in encoded message
 
-    if(nBytes+n>MAX_HTTP){                  // exceeded maximum number of bytes allowed in plaintext message
-      Serial.print("\n\n*** ERROR:  Exceeded maximum HTTP message length\n\n");
-      return(0);
+      if(reqLen+rxFrameLen>MAX_HTTP || rxFrameLen>1024){          // exceeded maximum number of bytes allowed in plaintext message or in a single frame
+        Serial.print("\n\n*** ERROR:  Exceeded maximum HTTP message length\n\n");
+        return(-1);
       }
 
-    if(client.read(buf+2,n+16)!=n+16){      // read expected number of total bytes = n bytes in encoded message + 16 bytes for appended authentication tag      
-      Serial.print("\n\n*** ERROR: Malformed encrypted message frame\n\n");
-      return(0);      
-    }                
+      if(!reserveRequest(rxFrameLen+16))                          // make room in reqBuf for encoded message + 16-byte authentication tag (error message already printed in function)
+        return(-1);
+        
+      rxGot=0;
+    }
+
+    if((r=client.read(reqBuf+reqLen+rxGot,rxFrameLen+16-rxGot))<=0)   // read encoded bytes directly into end of reqBuf
+      break;
+
+    if((rxGot+=r)<rxFrameLen+16)                                  // frame not yet complete
+      continue;
 
-    if(crypto_aead_chacha20poly1305_ietf_decrypt(httpBuf+nBytes, NULL, NULL, buf+2, n+16, buf, 2, c2aNonce.get(), c2aKey)==-1){
+    if(crypto_aead_chacha20poly1305_ietf_decrypt(reqBuf+reqLen, NULL, NULL, reqBuf+reqLen, rxFrameLen+16, rxAAD, 2, c2aNonce.get(), c2aKey)==-1){     // decrypt in place
       Serial.print("\n\n*** ERROR: Can't Decrypt Message\n\n");
-      return(0);        
+      return(-1);        
     }
 
     c2aNonce.inc();
 
-    nBytes+=n;          // increment total number of bytes in plaintext message
+    reqLen+=rxFrameLen;     // increment number of bytes stored in reqBuf
+    nBytes+=rxFrameLen;     // increment total number of bytes decrypted
+    rxAADLen=0;             // ready for next frame
+    rxGot=0;
     
   } // while
 
@@ -1375,44 +1780,73 @@ int HAPClient::receiveEncrypted(){
 void HAPClient::sendEncrypted(char *body, uint8_t *dataBuf, int dataLen){
 
   const int FRAME_SIZE=1024;          // number of bytes to use in each ChaCha20-Poly1305 encrypted frame when sending encrypted JSON content to Client
-  
-  int bodyLen=strlen(body);
+  const int MAX_FRAMES=4;             // maximum number of encrypted frames to collect in transmit buffer before writing them to Client in a single call
 
-  int count=0;
+  int msgLen=strlen(body)+dataLen;    // message is sent as the Body followed by dataLen bytes of data
+  int nFrames=(msgLen+FRAME_SIZE-1)/FRAME_SIZE;     // total number of frames needed
+  
+  TempBuffer <uint8_t> txBuf((nFrames<MAX_FRAMES?nFrames:MAX_FRAMES)*(2+FRAME_SIZE+16));     // transmit buffer for encrypted frames (each = 2-byte AAD record + up to FRAME_SIZE bytes + 16-byte authentication tag)
+  int txLen=0;                        // number of bytes in transmit buffer
   unsigned long long nBytes;
 
-  httpBuf[count]=bodyLen%256;         // store number of bytes in first frame that encrypts the Body (AAD bytes)
-  httpBuf[count+1]=bodyLen/256;
+  for(int i=0;i<msgLen;i+=FRAME_SIZE){           // encrypt FRAME_SIZE number of bytes at a time in sequential frames
   
-  crypto_aead_chacha20poly1305_ietf_encrypt(httpBuf+count+2,&nBytes,(uint8_t *)body,bodyLen,httpBuf+count,2,NULL,a2cNonce.get(),a2cKey);   // encrypt the Body with authentication tag appended
-
-  a2cNonce.inc();                 // increment nonce
+    int n=msgLen-i;            // number of bytes remaining
   
-  count+=2+bodyLen+16;            // increment count by 2-byte AAD record + length of Body + 16-byte authentication tag
-
-  for(int i=0;i<dataLen;i+=FRAME_SIZE){      // encrypt FRAME_SIZE number of bytes in dataBuf in sequential frames
-    
-    int n=dataLen-i;           // number of bytes remaining
-    
     if(n>FRAME_SIZE)           // maximum number of bytes to encrypt=FRAME_SIZE
       n=FRAME_SIZE;                                     
-    
-    httpBuf[count]=n%256;    // store number of bytes that encrypts this frame (AAD bytes)
-    httpBuf[count+1]=n/256;
 
-    crypto_aead_chacha20poly1305_ietf_encrypt(httpBuf+count+2,&nBytes,dataBuf+i,n,httpBuf+count,2,NULL,a2cNonce.get(),a2cKey);   // encrypt the next portion of dataBuf with authentication tag appended
+    if(txLen+2+n+16>txBuf.len()){     // no room for this frame - transmit frames collected so far
+      client.write(txBuf.buf,txLen);
+      txLen=0;
+    }
+
+    uint8_t *frame=txBuf.buf+txLen;   // build and encrypt directly in transmit buffer
+  
+    frame[0]=n%256;            // store number of bytes that encrypts this frame (AAD bytes)
+    frame[1]=n/256;
+
+    copyMessage(frame+2,body,dataBuf,i,n);      // copy next portion of message into frame
+
+    crypto_aead_chacha20poly1305_ietf_encrypt(frame+2,&nBytes,frame+2,n,frame,2,NULL,a2cNonce.get(),a2cKey);   // encrypt portion of message in place with authentication tag appended
 
     a2cNonce.inc();            // increment nonce
 
-    count+=2+n+16;             // increment count by 2-byte AAD record + length of JSON + 16-byte authentication tag
+    txLen+=2+n+16;
   }
-    
-  client.write(httpBuf,count);   // transmit all encrypted frames to Client
+
+  if(txLen)
+    client.write(txBuf.buf,txLen);      // transmit remaining frames
 
   LOG2("-------- SENT ENCRYPTED! --------\n");
       
 } // sendEncrypted
 
+//////////////////////////////////////
+
+void HAPClient::copyMessage(uint8_t *buf, char *body, uint8_t *dataBuf, int offset, int n){
+
+  int bodyLen=strlen(body);
+
+  if(offset<bodyLen){                   // copy portion of Body
+    int m=bodyLen-offset<n?bodyLen-offset:n;
+    memcpy(buf,body+offset,m);
+    buf+=m;
+    offset+=m;
+    n-=m;
+  }
+
+  if(n<=0)
+    return;
+
+  offset-=bodyLen;                      // offset into data that follows Body
+
+  if(dataBuf)
+    memcpy(buf,dataBuf+offset,n);       // copy portion of data
+  else
+    tlv8.pack(buf,offset,n);            // pack portion of TLV records directly into buf (fragmenting large records into 255-byte chunks)
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 
@@ -1537,6 +1971,8 @@ void HAPClient::removeControllers(){
   
   for(int i=0;i<MAX_CONTROLLERS;i++)
     controllers[i].allocated=false;
+
+  clearResumeSessions();
 }    
 
 //////////////////////////////////////
@@ -1551,6 +1987,7 @@ void HAPClient::removeController(uint8_t *id){
       charPrintRow(id,36);
     LOG2(slot->admin?" (admin)\n":" (regular)\n");
     slot->allocated=false;
+    clearResumeSessions(slot);
 
     if(nAdminControllers()==0){       // if no more admins, remove all controllers
       removeControllers();
@@ -1566,6 +2003,45 @@ void HAPClient::removeController(uint8_t *id){
 
 //////////////////////////////////////
 
+void HAPClient::saveResumeSession(Controller *c, uint8_t *id, uint8_t *sharedSecret){
+
+  ResumeSession *rs=resumeSessions;
+  
+  for(int i=1;i<MAX_RESUME && rs->controller;i++){        // find unused slot, else least-recently-used slot
+    if(!resumeSessions[i].controller || resumeSessions[i].lastUsed<rs->lastUsed)
+      rs=resumeSessions+i;
+  }
+
+  rs->controller=c;
+  memcpy(rs->ID,id,8);
+  memcpy(rs->sharedSecret,sharedSecret,32);
+  rs->lastUsed=++resumeCount;
+}
+
+//////////////////////////////////////
+
+ResumeSession *HAPClient::findResumeSession(uint8_t *id){
+
+  for(int i=0;i<MAX_RESUME;i++){
+    if(resumeSessions[i].controller && resumeSessions[i].controller->allocated && !memcmp(resumeSessions[i].ID,id,8))
+      return(resumeSessions+i);
+  }
+
+  return(NULL);
+}
+
+//////////////////////////////////////
+
+void HAPClient::clearResumeSessions(Controller *c){
+
+  for(int i=0;i<MAX_RESUME;i++){
+    if(!c || resumeSessions[i].controller==c)
+      resumeSessions[i].controller=NULL;
+  }
+}
+
+//////////////////////////////////////
+
 void HAPClient::printControllers(){
 
   int n=0;
@@ -1617,13 +2093,26 @@ void Nonce::inc(){
 
 // instantiate all static HAP Client structures and data
 
-TLV<kTLVType,10> HAPClient::tlv8;
+HapTLV HAPClient::tlv8(hapTLVRecords);
+ResumeSession HAPClient::resumeSessions[MAX_RESUME];
+TaskHandle_t HAPClient::srpTaskHandle=NULL;
+std::atomic<int> HAPClient::srpStatus(HAPClient::srpIdle);
+pairState HAPClient::srpStep;
+int HAPClient::srpClient;
+int HAPClient::pairSetupClient=-1;
+uint32_t HAPClient::pairSetupID=0;
+unsigned long HAPClient::pairSetupTime;
+uint32_t HAPClient::srpID;
+uint32_t HAPClient::connectionCount=0;
+boolean HAPClient::srpVerified;
+unsigned long HAPClient::srpStart;
+unsigned long HAPClient::srpCalcStart;
+uint32_t HAPClient::resumeCount=0;
 nvs_handle HAPClient::hapNVS;
 nvs_handle HAPClient::wifiNVS;
 nvs_handle HAPClient::srpNVS;
-uint8_t HAPClient::httpBuf[MAX_HTTP+1];                 
 HKDF HAPClient::hkdf;                                   
-pairState HAPClient::pairStatus;                        
+pairState HAPClient::pairStatus=pairState_M1;
 Accessory HAPClient::accessory;                         
 Controller HAPClient::controllers[MAX_CONTROLLERS];    
 SRP6A HAPClient::srp;
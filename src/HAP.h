@@ -29,6 +29,7 @@
 
 #include <WiFi.h>
 #include <nvs.h>
+#include <atomic>
 
 #include "HomeSpan.h"
 #include "TLV.h"
@@ -66,6 +67,36 @@ struct Accessory {
   uint8_t LTPK[32];        // public key for Ed25519 signatures
 };
 
+/////////////////////////////////////////////////
+// Resumable Pair-Verify Session
+
+struct ResumeSession {
+  Controller *controller=NULL;    // Controller that verified the session (NULL=slot unused)
+  uint8_t ID[8];                  // Session ID used by Controller to request Pair-Resume
+  uint8_t sharedSecret[32];       // Shared Secret of the session, from which the Shared Secret of a resumed session is derived
+  uint32_t lastUsed=0;            // sequence number of last use, for least-recently-used replacement
+};
+
+/////////////////////////////////////////////////
+// TLV8 Records used by HAP (HAP Table 5-6)
+// Sizes and initializes the TLV8 workspace, HAPClient::tlv8
+
+constexpr TLVRecord<kTLVType> hapTLVRecords[]={
+  {kTLVType_State,1,"STATE"},
+  {kTLVType_PublicKey,384,"PUBKEY"},
+  {kTLVType_Method,1,"METHOD"},
+  {kTLVType_Salt,16,"SALT"},
+  {kTLVType_Error,1,"ERROR"},
+  {kTLVType_Proof,64,"PROOF"},
+  {kTLVType_EncryptedData,1024,"ENC.DATA"},
+  {kTLVType_Signature,64,"SIGNATURE"},
+  {kTLVType_Identifier,64,"IDENTIFIER"},
+  {kTLVType_Permissions,1,"PERMISSION"},
+  {kTLVType_SessionID,8,"SESSION.ID"}
+};
+
+typedef TLV<kTLVType,tlvCount(hapTLVRecords),tlvBytes(hapTLVRecords)> HapTLV;
+
 /////////////////////////////////////////////////
 // HAPClient Structure
 // Reads and Writes from each HAP Client connection
@@ -74,24 +105,45 @@ struct HAPClient {
 
   // common structures and data shared across all HAP Clients
 
-  static const int MAX_HTTP=8095;                     // max number of bytes in HTTP message buffer
+  static const int MAX_HTTP=8095;                     // max number of bytes in HTTP request
   static const int MAX_CONTROLLERS=16;                // maximum number of paired controllers (HAP requires at least 16)
+  static const int MAX_RESUME=8;                      // maximum number of Pair-Verify sessions cached for Pair-Resume
   
-  static TLV<kTLVType,10> tlv8;                       // TLV8 structure (HAP Section 14.1) with space for 10 TLV records of type kTLVType (HAP Table 5-6)
+  static HapTLV tlv8;                                 // TLV8 workspace (HAP Section 14.1) with one TLV record for each entry in hapTLVRecords - shared, since each request is parsed and answered before the next is read
   static nvs_handle hapNVS;                           // handle for non-volatile-storage of HAP data
   static nvs_handle wifiNVS;                          // handle for non-volatile-storage of WiFi data
   static nvs_handle srpNVS;                           // handle for non-volatile-storage of SRP data
-  static uint8_t httpBuf[MAX_HTTP+1];                 // buffer to store HTTP messages (+1 to leave room for storing an extra 'overflow' character)
   static HKDF hkdf;                                   // generates (and stores) HKDF-SHA-512 32-byte keys derived from an inputKey of arbitrary length, a salt string, and an info string
   static pairState pairStatus;                        // tracks pair-setup status
+  static int pairSetupClient;                         // connection number that owns the current Pair-Setup exchange (-1 if none) - other connections receive a Busy error until it completes, disconnects, or times out
+  static uint32_t pairSetupID;                        // connectionID of connection that owns the current Pair-Setup exchange (guards against slot being re-used by a new connection)
+  static unsigned long pairSetupTime;                 // time (in millis) of last Pair-Setup request from owner
+  static const int PAIR_SETUP_TIMEOUT=30000;          // time (in millis) after which an inactive owner loses ownership of Pair-Setup
+  static uint32_t connectionCount;                    // running count of connections - used to assign each connection a unique connectionID
   static SRP6A srp;                                   // stores all SRP-6A keys used for Pair-Setup
   static Accessory accessory;                         // Accessory ID and Ed25519 public and secret keys- permanently stored
   static Controller controllers[MAX_CONTROLLERS];     // Paired Controller IDs and ED25519 long-term public keys - permanently stored
   static int conNum;                                  // connection number - used to keep track of per-connection EV notifications
+  static ResumeSession resumeSessions[MAX_RESUME];    // recently-verified sessions that Controllers can resume without a full Pair-Verify
+  static uint32_t resumeCount;                        // running count of cache uses - used to find least-recently-used ResumeSession
+
+  // SRP calculations for Pair-Setup <M1> and <M3> take seconds, so they are performed by a separate worker task while poll() continues to serve other connections; the response is sent once the calculation is complete.
+  // While the device is unpaired, poll() also uses the worker task to precompute the <M1> public key ahead of time.  Such a calculation has no waiting connection (srpClient=-1) until a Pair-Setup <M1> request claims it.
+
+  enum {srpIdle=0, srpRunning=1, srpDone=2};
+  static TaskHandle_t srpTaskHandle;                  // handle to SRP worker task (created on first use)
+  static std::atomic<int> srpStatus;                  // status of SRP calculation (srpIdle, srpRunning, or srpDone)
+  static pairState srpStep;                           // Pair-Setup step for which calculation was requested (pairState_M1 or pairState_M3)
+  static int srpClient;                               // connection number waiting for result of SRP calculation (-1 if public key is being precomputed with no connection waiting)
+  static uint32_t srpID;                              // connectionID of connection waiting for result of SRP calculation
+  static boolean srpVerified;                         // result of SRP proof verification for <M3>
+  static unsigned long srpCalcStart;                  // time (in millis) SRP calculation was started
+  static unsigned long srpStart;                      // time (in millis) Pair-Setup step began
 
   // individual structures and data defined for each Hap Client connection
   
-  WiFiClient client=0;            // handle to client
+  WiFiClient client;              // handle to client
+  uint32_t connectionID=0;        // unique ID of current connection in this slot
   Controller *cPair;              // pointer to info on current, session-verified Paired Controller (NULL=un-verified, and therefore un-encrypted, connection)
    
   // These keys are generated in the first call to pair-verify and used in the second call to pair-verify so must persist for a short period
@@ -108,11 +160,37 @@ struct HAPClient {
   Nonce a2cNonce;                 // encryption nonce (starts at zero at end of each Pair-Verify and increment every encryption - NOT DOCUMENTED)
   Nonce c2aNonce;                 // decryption nonce (starts at zero at end of each Pair-Verify and increment every encryption - NOT DOCUMENTED)
 
+  // HTTP requests can span more than one TCP segment, and therefore more than one call to processRequest(), so the request is collected in a per-connection buffer until complete
+
+  uint8_t *reqBuf=NULL;                       // buffer holding (decrypted) bytes of HTTP request received so far (allocated on demand and freed once all requests in buffer are processed)
+  int reqLen=0;                               // number of bytes stored in reqBuf
+  int reqCap=0;                               // allocated size of reqBuf
+  int reqScan=0;                              // position in reqBuf from which to resume search for blank line that ends the HTTP header
+  int reqHeaderLen=0;                         // length of HTTP header, including blank line (0 = header not yet complete)
+  int reqContentLen=0;                        // Content-Length specified in HTTP header
+  contentType reqContentType;                 // Content-Type specified in HTTP header
+
+  // Encrypted frames can also span more than one TCP segment, so each frame is read directly into reqBuf following the decrypted bytes (and decrypted in place) once complete
+
+  uint8_t rxAAD[2];                           // 2-byte AAD record (frame length) of encrypted frame being received
+  int rxAADLen=0;                             // number of AAD bytes received so far (0 = waiting for next frame)
+  int rxFrameLen=0;                           // number of encrypted bytes in frame being received (excluding 16-byte authentication tag)
+  int rxGot=0;                                // number of encrypted bytes and tag bytes of frame received so far, stored at reqBuf+reqLen
+
+  vector<SpanCharacteristic *> subscriptions;  // Characteristics for which this connection has requested Event Notifications (reverse index of Span::evTable, maintained by Span::setEv() and Span::clearNotify())
+
   // define member methods
 
-  void processRequest();                       // process HAP request  
+  void processRequest();                       // read available bytes from client and process any HAP requests that are complete
+  int parseRequest();                          // parses HTTP header once received; returns 1 if a complete request is in reqBuf, 0 if more bytes are needed, or -1 if request is malformed
+  void dispatchRequest(char *body, uint8_t *content, int cLen);     // process a complete HAP request with null-terminated HTTP header 'body' and 'cLen' bytes of 'content'
+  uint8_t *reserveRequest(int nBytes);         // ensures reqBuf has room for nBytes more bytes (plus a trailing null) and returns pointer to end of request data (or NULL, after discarding request, if memory can't be allocated)
+  void clearRequest();                         // frees reqBuf and resets request parser
   int postPairSetupURL();                      // POST /pair-setup (HAP Section 5.6)
+  void pairSetupM2();                          // sends Pair-Setup <M2> response once SRP public key is ready
+  void pairSetupM4();                          // sends Pair-Setup <M4> response once SRP session key has been created and proof verified
   int postPairVerifyURL();                     // POST /pair-verify (HAP Section 5.7)
+  int pairResume();                            // attempts Pair-Resume of a cached session from TLV records of a POST /pair-verify request; returns 1 (and responds to client) on success, else 0 so that a full Pair-Verify can be performed
   int getAccessoriesURL();                     // GET /accessories (HAP Section 6.6)
   int postPairingsURL();                       // POST /pairings (HAP Sections 5.10-5.12)  
   int getCharacteristicsURL(char *urlBuf);     // GET /characteristics (HAP Section 6.7.4)  
@@ -120,12 +198,13 @@ struct HAPClient {
   int putPrepareURL(char *json);               // PUT /prepare (HAP Section 6.7.2.4)
 
   void tlvRespond();                                                // respond to client with HTTP OK header and all defined TLV data records (those with length>0)
-  void sendEncrypted(char *body, uint8_t *dataBuf, int dataLen);    // send client complete ChaCha20-Poly1305 encrypted HTTP mesage comprising a null-terminated 'body' and 'dataBuf' with 'dataLen' bytes
-  int receiveEncrypted();                                           // decrypt HTTP request (HAP Section 6.5)
+  void sendEncrypted(char *body, uint8_t *dataBuf, int dataLen);    // send client complete ChaCha20-Poly1305 encrypted HTTP mesage comprising a null-terminated 'body' and 'dataBuf' with 'dataLen' bytes (or dataLen bytes packed from tlv8 if dataBuf=NULL), writing up to 4 frames at a time
+  int receiveEncrypted();                                           // read all available bytes of encrypted frames into reqBuf and decrypt each complete frame in place (HAP Section 6.5); returns number of bytes decrypted, or -1 on error
 
   int notFoundError();           // return 404 error
   int badRequestError();         // return 400 error
   int unauthorizedError();       // return 470 error
+  int resourceError();           // return (encrypted) 503 error when a response can't be created because memory is exhausted
 
   // define static methods
     
@@ -134,6 +213,7 @@ struct HAPClient {
   static void hexPrintColumn(uint8_t *buf, int n);     // prints 'n' bytes of *buf as HEX, one byte per row.  For diagnostics/debugging only
   static void hexPrintRow(uint8_t *buf, int n);        // prints 'n' bytes of *buf as HEX, all on one row
   static void charPrintRow(uint8_t *buf, int n);       // prints 'n' bytes of *buf as CHAR, all on one row
+  static void copyMessage(uint8_t *buf, char *body, uint8_t *dataBuf, int offset, int n);     // copies 'n' bytes, starting at 'offset', of message comprising 'body' followed by 'dataBuf' (or packed tlv8 records if dataBuf=NULL) into buf
   
   static Controller *findController(uint8_t *id);                                      // returns pointer to controller with mathching ID (or NULL if no match)
   static Controller *getFreeController();                                              // return pointer to next free controller slot (or NULL if no free slots)
@@ -142,10 +222,19 @@ struct HAPClient {
   static void removeControllers();                                                     // removes all Controllers (sets allocated flags to false for all slots)
   static void removeController(uint8_t *id);                                           // removes specific Controller.  If no remaining admin Controllers, remove all others (if any) as per HAP requirements.
   static void printControllers();                                                      // prints IDs of all allocated (paired) Controller
+  static void saveResumeSession(Controller *c, uint8_t *id, uint8_t *sharedSecret);    // caches session of Controller 'c', replacing least-recently-used session if cache is full
+  static ResumeSession *findResumeSession(uint8_t *id);                                // returns pointer to cached session with matching 8-byte Session ID (or NULL if no match)
+  static void clearResumeSessions(Controller *c=NULL);                                 // removes all cached sessions of Controller 'c' (or all sessions if c=NULL)
   static void callServiceLoops();                                                      // call the loop() method for any Service with that over-rode the default method
   static void checkPushButtons();                                                      // checks for PushButton presses and calls button() method of attached Services when found
   static void checkNotifications();                                                    // checks for Event Notifications and reports to controllers as needed (HAP Section 6.8)
   static void checkTimedWrites();                                                      // checks for expired Timed Write PIDs, and clears any found (HAP Section 6.7.2.4)
+  static void startSRP(pairState step);                                                // hands SRP calculation for Pair-Setup step to worker task
+  static void precomputeSRP();                                                         // hands precomputation of Pair-Setup <M1> public key to worker task, if device is unpaired and worker task is idle
+  static boolean srpBusy(){return(srpStatus!=srpIdle && srpClient>=0);}                // returns true if a connection is waiting for the result of an SRP calculation
+  static void srpTask(void *arg);                                                      // SRP worker task
+  static void srpCalculate();                                                          // performs SRP calculation for Pair-Setup step srpStep
+  static void checkSRP();                                                              // sends deferred Pair-Setup response if SRP worker task has finished, and releases Pair-Setup if owner has been inactive for PAIR_SETUP_TIMEOUT
   static void eventNotify(SpanBuf *pObj, int nObj, int ignoreClient=-1);               // transmits EVENT Notifications for nObj SpanBuf objects, pObj, with optional flag to ignore a specific client
 };
 
@@ -44,6 +44,7 @@ typedef enum {
   kTLVType_Permissions=0x0B,
   kTLVType_FragmentData=0x0C,
   kTLVType_FragmentLast=0x0D,
+  kTLVType_SessionID=0x0E,
   kTLVType_Flags=0x13,
   kTLVType_Separator=0xFF
 } kTLVType;
@@ -74,6 +75,14 @@ typedef enum {
   pairState_M6=6
 } pairState;
 
+// HTTP Content-Types recognized when parsing HAP requests
+
+typedef enum {
+  contentType_None=0,
+  contentType_TLV8=1,            // application/pairing+tlv8
+  contentType_JSON=2             // application/hap+json
+} contentType;
+
 // HAP Status Codes (HAP Table 6-11)
 
 enum class StatusCode {  
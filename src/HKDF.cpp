@@ -45,6 +45,16 @@ int HKDF::create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const char
   
 }
 
+int HKDF::create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, uint8_t *salt, int saltLen, const char *info){
+  
+  return(mbedtls_hkdf( mbedtls_md_info_from_type(MBEDTLS_MD_SHA512),
+                salt, (size_t) saltLen,
+                inputKey, (size_t) inputLen,
+                (uint8_t *) info, (size_t) strlen(info),
+                outputKey, 32 ));
+  
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 // CODE FOR HKDF IS MISSING FROM THE MBEDTLS LIBRARY INCLUDED WITH THE
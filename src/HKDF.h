@@ -40,4 +40,5 @@
 
 struct HKDF {
   int create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const char *salt, const char *info);    // output of HKDF is always a 32-byte key derived from an input key, a salt string, and an info string
+  int create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, uint8_t *salt, int saltLen, const char *info);    // same as above, but with a binary salt of saltLen bytes
 };
@@ -29,6 +29,7 @@
 #include <nvs_flash.h>
 #include <sodium.h>
 #include <WiFi.h>
+#include <lwip/sockets.h>
 
 #include "HomeSpan.h"
 #include "HAP.h"
@@ -91,6 +92,12 @@ void Span::begin(Category catID, const char *displayName, const char *hostNameBa
 
 void Span::poll() {
 
+  if(pollTaskHandle && xTaskGetCurrentTaskHandle()!=pollTaskHandle){     // HAP requests are handled by the autoPoll() task, so calls from the sketch's task only run the Service loop() and button() methods
+    if(isInitialized)
+      pollServices();
+    return;
+  }
+
   if(!strlen(category)){
     Serial.print("\n** FATAL ERROR: Cannot run homeSpan.poll() without an initial call to homeSpan.begin()!\n** PROGRAM HALTED **\n\n");
     while(1);    
@@ -120,6 +127,7 @@ void Span::poll() {
 
     Serial.print("\n");
         
+    buildIndex();             // index Accessories and Characteristics for fast look-up by aid/iid
     HAPClient::init();        // read NVS and load HAP settings  
 
     if(strlen(network.wifiData.ssid)>0){
@@ -148,13 +156,29 @@ void Span::poll() {
     processSerialCommand(cBuf);
   }
 
+  unsigned long pollStart=micros();           // start timing this poll (excludes initialization, WiFi re-connects, and CLI commands above, which wait on the user and would otherwise count the 't' command's own output in the statistics it resets)
+
+  boolean idle=true;                            // set to false if this poll accepts a new client or processes a HAP request
   WiFiClient newClient;
+  uint32_t passStart=HAPClient::connectionCount;       // connections with a connectionID greater than this were accepted during this pass
 
-  if(newClient=hapServer.available()){         // found a new HTTP client
+  while(newClient=hapServer.available()){      // accept every pending HTTP client in one pass
+    idle=false;
     int freeSlot=getFreeSlot();                 // get next free slot
 
     if(freeSlot==-1){                           // no available free slots
-      freeSlot=randombytes_uniform(maxConnections);
+      freeSlot=getEvictionSlot(passStart);      // choose a random slot to free, excluding any slot filled during this pass
+
+      if(freeSlot==-1){                         // every slot was filled during this pass - refuse new client rather than evict one just accepted
+        LOG1("** Refusing Client (");
+        LOG1(millis()/1000);
+        LOG1(" sec) ");
+        LOG1(newClient.remoteIP());
+        LOG1(" - all slots in use\n");
+        newClient.stop();
+        continue;
+      }
+
       LOG2("=======================================\n");
       LOG1("** Freeing Client #");
       LOG1(freeSlot);
@@ -179,34 +203,96 @@ void Span::poll() {
     LOG2("\n");
 
     hap[freeSlot]->cPair=NULL;                   // reset pointer to verified ID
+    hap[freeSlot]->clearRequest();              // discard any partial request left over from prior connection in this slot
     homeSpan.clearNotify(freeSlot);             // clear all notification requests for this connection
-    HAPClient::pairStatus=pairState_M1;         // reset starting PAIR STATE (which may be needed if Accessory failed in middle of pair-setup)
+    hap[freeSlot]->connectionID=++HAPClient::connectionCount;     // assign unique ID so that Pair-Setup state of any prior connection in this slot is not applied to this one
+  }
+
+  fd_set readSet;                                        // set of client sockets to check for readability
+  FD_ZERO(&readSet);
+  int maxFd=-1;
+
+  for(int i=0;i<maxConnections;i++){                     // add socket of every connected slot to readSet
+    int fd=hap[i]->client.fd();
+    if(hap[i]->client && fd>=LWIP_SOCKET_OFFSET){
+      FD_SET(fd,&readSet);
+      if(fd>maxFd)
+        maxFd=fd;
+    }
+  }
+
+  boolean selectOK=true;
+
+  if(maxFd>=0){
+    struct timeval timeout={0,0};                        // do not block - user-defined Service loops() must still be called every poll
+    if(select(maxFd+1,&readSet,NULL,NULL,&timeout)<0)    // select failed - fall back to checking each client with available()
+      selectOK=false;
   }
 
   for(int i=0;i<maxConnections;i++){                     // loop over all HAP Connection slots
     
-    if(hap[i]->client && hap[i]->client.available()){       // if connection exists and data is available
+    if(!hap[i]->client)                                  // skip slots without a connection
+      continue;
 
-      HAPClient::conNum=i;                                // set connection number
-      hap[i]->processRequest();                           // process HAP request
-      
-      if(!hap[i]->client){                                 // client disconnected by server
-        LOG1("** Disconnecting Client #");
-        LOG1(i);
-        LOG1("  (");
-        LOG1(millis()/1000);
-        LOG1(" sec)\n");
-      }
+    int fd=hap[i]->client.fd();
+    int nBytes=hap[i]->client.available();               // WiFiClient may already hold buffered data that select() cannot see
+    boolean readable=selectOK && fd>=LWIP_SOCKET_OFFSET && FD_ISSET(fd,&readSet);
+    
+    if(!readable && nBytes<=0)                           // skip slots with nothing to read
+      continue;
+
+    idle=false;
+
+    if(nBytes<=0){                                       // socket is readable but has no data, which means the Controller closed the connection
+      hap[i]->client.stop();
+      hap[i]->clearRequest();                            // discard any partial request
+      clearNotify(i);                                    // clear all notification requests for this connection
+      LOG1("** Client #");
+      LOG1(i);
+      LOG1(" Disconnected by Controller (");
+      LOG1(millis()/1000);
+      LOG1(" sec)\n");
+      continue;
+    }
+    
+    HAPClient::conNum=i;                                // set connection number
+    unsigned long reqStart=micros();
+    hap[i]->processRequest();                           // process HAP request
+    stats.nRequests++;
+    stats.tally(stats.requestTime,stats.maxRequestTime,reqStart);
+    
+    if(!hap[i]->client){                                 // client disconnected by server
+      hap[i]->clearRequest();                            // discard any partial request
+      clearNotify(i);                                    // clear all notification requests for this connection
+      LOG1("** Disconnecting Client #");
+      LOG1(i);
+      LOG1("  (");
+      LOG1(millis()/1000);
+      LOG1(" sec)\n");
+    }
 
-      LOG2("\n");
+    LOG2("\n");
 
-    } // process HAP Client 
   } // for-loop over connection slots
 
-  HAPClient::callServiceLoops();
-  HAPClient::checkPushButtons();
+  SpanSetVal sv;
+  
+  while(setValQueue.pop(sv)){                            // apply any calls to setVal() made from the sketch's task while autoPoll() is running
+    if(sv.isFloat)
+      sv.characteristic->setVal(sv.fVal);
+    else
+      sv.characteristic->setVal(sv.iVal);
+  }
+
+  if(!pollTaskHandle)                                    // with autoPoll() running, Service loops are instead run by the sketch's own calls to poll()
+    pollServices();
+
+  unsigned long notifyStart=micros();
   HAPClient::checkNotifications();  
+  stats.tally(stats.notifyTime,stats.maxNotifyTime,notifyStart);
+  
   HAPClient::checkTimedWrites();
+  HAPClient::checkSRP();
 
   if(controlButton.primed()){
     statusLED.start(LED_ALERT);
@@ -221,11 +307,73 @@ void Span::poll() {
       commandMode();                    // COMMAND MODE
     }
   }
+
+  stats.nPolls++;
+  stats.tally(stats.pollTime,stats.maxPollTime,pollStart);
+
+  if(idle){
+    stats.nIdlePolls++;
+    stats.tally(stats.idleTime,stats.maxIdleTime,pollStart);
+    HAPClient::precomputeSRP();                           // if unpaired, have SRP worker task prepare keys so Pair-Setup <M1> can be answered immediately
+  }
     
 } // poll
 
 ///////////////////////////////
 
+void Span::pollServices(){
+
+  unsigned long loopStart=micros();
+  HAPClient::callServiceLoops();
+  HAPClient::checkPushButtons();
+  stats.tally(stats.loopTime,stats.maxLoopTime,loopStart);
+}
+
+///////////////////////////////
+
+void Span::autoPoll(uint32_t stackSize, uint32_t priority, int cpu){
+
+  if(pollTaskHandle){
+    Serial.print("*** WARNING: autoPoll() already running - request ignored\n\n");
+    return;
+  }
+
+  if(xTaskCreatePinnedToCore(pollTask,"pollTask",stackSize,NULL,priority,&pollTaskHandle,cpu)!=pdPASS){
+    Serial.print("*** ERROR: Can't create autoPoll() task!\n\n");
+    pollTaskHandle=NULL;
+    return;
+  }
+  
+  LOG1("Started HAP polling task on cpu ");
+  LOG1(cpu);
+  LOG1("\n");
+}
+
+///////////////////////////////
+
+void Span::pollTask(void *arg){
+
+  for(;;){
+    homeSpan.poll();
+    vTaskDelay(1);              // yield so lower-priority tasks (including the IDLE task that feeds the watchdog) can run
+  }
+}
+
+///////////////////////////////
+
+boolean Span::deferSetVal(SpanSetVal &sv){
+
+  if(!pollTaskHandle || xTaskGetCurrentTaskHandle()==pollTaskHandle)       // called from within the polling task (e.g. a Service update()), or autoPoll() not running
+    return(false);
+
+  while(!setValQueue.push(sv))                                              // queue is full - wait for polling task to catch up
+    vTaskDelay(1);
+
+  return(true);
+}
+
+//////////////////////////////////////
+
 int Span::getFreeSlot(){
   
   for(int i=0;i<maxConnections;i++){
@@ -238,6 +386,30 @@ int Span::getFreeSlot(){
 
 //////////////////////////////////////
 
+int Span::getEvictionSlot(uint32_t passStart){
+
+  int nEligible=0;
+
+  for(int i=0;i<maxConnections;i++){                 // count slots holding a connection accepted before the current pass
+    if(hap[i]->connectionID<=passStart)
+      nEligible++;
+  }
+
+  if(nEligible==0)
+    return(-1);
+
+  int n=randombytes_uniform(nEligible);
+
+  for(int i=0;i<maxConnections;i++){                 // return n-th eligible slot
+    if(hap[i]->connectionID<=passStart && n--==0)
+      return(i);
+  }
+
+  return(-1);
+}
+
+//////////////////////////////////////
+
 void Span::commandMode(){
   
   Serial.print("*** ENTERING COMMAND MODE ***\n\n");
@@ -466,15 +638,20 @@ void Span::processSerialCommand(const char *c){
 
     case 'd': {      
       
-      TempBuffer <char> qBuf(sprintfAttributes(NULL)+1);
-      sprintfAttributes(qBuf.buf);  
+      JsonWriter json(4096);
+      writeAttributes(json);
+
+      if(json.overflow){
+        Serial.print("\n*** ERROR: Can't create Attributes database\n\n");
+        break;
+      }
 
       Serial.print("\n*** Attributes Database: size=");
-      Serial.print(qBuf.len()-1);
+      Serial.print(json.len);
       Serial.print("  configuration=");
       Serial.print(hapConfig.configNumber);
       Serial.print(" ***\n\n");
-      prettyPrint(qBuf.buf);
+      prettyPrint(json.buf);
       Serial.print("\n*** End Database ***\n\n");
     }
     break;
@@ -497,14 +674,20 @@ void Span::processSerialCommand(const char *c){
       
       if(!network.allowedCode(setupCode)){
         Serial.print("\n*** Invalid request to change Setup Code.  Code too simple.\n");
+      } else
+      
+      if(HAPClient::srpStatus!=HAPClient::srpIdle || HAPClient::pairStatus!=pairState_M1){      // SRP data is in use by a Pair-Setup in progress (possibly in SRP worker task)
+        Serial.print("\n*** Can't change Setup Code while Pair-Setup is in progress.  Please try again later.\n");
       } else {
         
         sprintf(buf,"\n\nGenerating SRP verification data for new Setup Code: %.3s-%.2s-%.3s ... ",setupCode,setupCode+3,setupCode+5);
         Serial.print(buf);
+        unsigned long codeStart=millis();
         HAPClient::srp.createVerifyCode(setupCode,verifyData.verifyCode,verifyData.salt);                         // create verification code from default Setup Code and random salt
         nvs_set_blob(HAPClient::srpNVS,"VERIFYDATA",&verifyData,sizeof(verifyData));                              // update data
         nvs_commit(HAPClient::srpNVS);                                                                            // commit to NVS
-        Serial.print("New Code Saved!\n");
+        sprintf(buf,"New Code Saved! (%lu ms)\n",millis()-codeStart);
+        Serial.print(buf);
       }            
     }
     break;
@@ -677,12 +860,48 @@ void Span::processSerialCommand(const char *c){
     }
     break;
 
+    case 't': {
+
+      stats.print();
+      stats.reset();
+    }
+    break;
+
+    case 'n': {
+
+      Serial.print("\n*** Event Notification Subscriptions ***\n\n");
+      
+      int total=0;
+      
+      for(int i=0;i<maxConnections;i++){
+        if(hap[i]->client){
+          Serial.print("Connection #");
+          Serial.print(i);
+          Serial.print(" ");
+          Serial.print(hap[i]->client.remoteIP());
+          Serial.print(": ");
+          Serial.print(hap[i]->subscriptions.size());
+          Serial.print(" of ");
+          Serial.print(nCharacteristics);
+          Serial.print(" Characteristics\n");
+          total+=hap[i]->subscriptions.size();
+        }
+      }
+
+      Serial.print("\nTotal Subscriptions: ");
+      Serial.print(total);
+      Serial.print("\n\n*** End Subscriptions ***\n\n");
+    }
+    break;
+
     case '?': {    
       
       Serial.print("\n*** HomeSpan Commands ***\n\n");
       Serial.print("  s - print connection status\n");
       Serial.print("  i - print summary information about the HAP Database\n");
       Serial.print("  d - print the full HAP Accessory Attributes Database in JSON format\n");
+      Serial.print("  t - print timing statistics for poll() and reset them\n");
+      Serial.print("  n - print number of Event Notification subscriptions for each connection\n");
       Serial.print("\n");      
       Serial.print("  W - configure WiFi Credentials and restart\n");      
       Serial.print("  X - delete WiFi Credentials and restart\n");      
@@ -715,20 +934,65 @@ void Span::processSerialCommand(const char *c){
 
 ///////////////////////////////
 
-int Span::sprintfAttributes(char *cBuf){
+void Span::writeAttributes(JsonWriter &json){
+
+  if(!attributeCache.json)
+    buildCache();
+
+  if(!attributeCache.json){                                       // cache could not be built
+    json.overflow=true;
+    return;
+  }
+
+  json.reserve(attributeCache.len+attributeCache.slots.size()*8);     // pre-allocate enough room for skeleton plus typical values
+
+  int pos=0;
 
-  int nBytes=0;
+  for(int i=0;i<attributeCache.slots.size();i++){                 // copy each segment of cached skeleton followed by current value of Characteristic
+    SpanSlot *slot=&attributeCache.slots[i];
+    json.add(attributeCache.json+pos,slot->offset-pos);
+    slot->characteristic->writeValue(json,0);
+    pos=slot->offset;
+  }
+
+  json.add(attributeCache.json+pos,attributeCache.len-pos);       // copy final segment
+}
+
+///////////////////////////////
 
-  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"accessories\":[");
+void Span::writeDatabase(JsonWriter &json){
+
+  json.add("{\"accessories\":[");
 
   for(int i=0;i<Accessories.size();i++){
-    nBytes+=Accessories[i]->sprintfAttributes(cBuf?(cBuf+nBytes):NULL);    
-    if(i+1<Accessories.size())
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",");
-    }
+    if(i>0)
+      json.add(',');
+    Accessories[i]->writeAttributes(json);    
+  }
     
-  nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"]}");
-  return(nBytes);
+  json.add("]}");
+}
+
+///////////////////////////////
+
+void Span::buildCache(){
+
+  JsonWriter json(4096);
+
+  attributeCache.building=true;                                   // Characteristics record value slots instead of writing values
+  attributeCache.slots.clear();
+  writeDatabase(json);
+  attributeCache.building=false;
+  attributeCache.slots.shrink_to_fit();
+
+  if(json.overflow || !(attributeCache.json=(char *)malloc(json.len+1))){     // leave attributeCache.json as NULL so it is re-built on next use
+    Serial.print("*** ERROR: Can't allocate Attributes database cache\n\n");
+    attributeCache.slots.clear();
+    return;
+  }
+
+  attributeCache.len=json.len;
+  memcpy(attributeCache.json,json.buf,json.len+1);
 }
 
 ///////////////////////////////
@@ -778,26 +1042,41 @@ void Span::prettyPrint(char *buf, int nsp){
 
 SpanCharacteristic *Span::find(uint32_t aid, int iid){
 
-  int index=-1;
-  for(int i=0;i<Accessories.size();i++){   // loop over all Accessories to find aid
-    if(Accessories[i]->aid==aid){          // if match, save index into Accessories array
-      index=i;
-      break;
-    }
-  }
+  auto it=aidIndex.find(aid);         // look up Accessory with matching aid
 
-  if(index<0)                  // fail if no match on aid
+  if(it==aidIndex.end())              // fail if no match on aid
     return(NULL);
+
+  SpanAccessory *acc=it->second;
     
-  for(int i=0;i<Accessories[index]->Services.size();i++){                           // loop over all Services in this Accessory
-    for(int j=0;j<Accessories[index]->Services[i]->Characteristics.size();j++){     // loop over all Characteristics in this Service
-      
-      if(iid == Accessories[index]->Services[i]->Characteristics[j]->iid)           // if matching iid
-        return(Accessories[index]->Services[i]->Characteristics[j]);                // return pointer to Characteristic
+  if(iid<1 || iid>=acc->iidTable.size())      // fail if iid is out of range
+    return(NULL);
+
+  return(acc->iidTable[iid]);                 // return pointer to Characteristic (NULL if iid belongs to a Service)
+}
+
+///////////////////////////////
+
+void Span::buildIndex(){
+
+  aidIndex.clear();
+  aidIndex.reserve(Accessories.size());
+
+  for(int i=0;i<Accessories.size();i++){
+    SpanAccessory *acc=Accessories[i];
+    aidIndex[acc->aid]=acc;
+    acc->iidTable.assign(acc->iidCount+1,NULL);                          // iids run from 1 through iidCount
+    for(int j=0;j<acc->Services.size();j++){
+      for(int k=0;k<acc->Services[j]->Characteristics.size();k++){
+        SpanCharacteristic *c=acc->Services[j]->Characteristics[k];
+        acc->iidTable[c->iid]=c;
+      }
     }
   }
 
-  return(NULL);                // fail if no match on iid
+  evWords=(nCharacteristics+31)/32;                                       // one bit per Characteristic, rounded up to whole words
+  free(evTable);
+  evTable=(uint32_t *)calloc(maxConnections*evWords,sizeof(uint32_t));   // single contiguous block for all connection slots
 }
 
 ///////////////////////////////
@@ -806,86 +1085,132 @@ int Span::countCharacteristics(char *buf){
 
   int nObj=0;
   
-  const char tag[]="\"aid\"";
-  while(buf=strstr(buf,tag)){         // count number of characteristic objects in PUT JSON request
+  while((buf=strchr(buf,'{'))){       // count number of opening braces in PUT JSON request
     nObj++;
-    buf+=strlen(tag);
+    buf++;
   }
 
-  return(nObj);
+  if(nObj>0)                          // exclude outer object
+    nObj--;
+
+  if(nObj>nCharacteristics)           // a valid request cannot reference more objects than there are Characteristics
+    nObj=nCharacteristics;
+
+  return(nObj);                       // upper bound on the number of characteristic objects
 }
 
 ///////////////////////////////
 
-int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
+int Span::updateCharacteristics(char *buf, SpanBuf *pObj, int maxObj){
 
+  JsonReader json(buf);
   int nObj=0;
-  char *p1;
-  int cFound=0;
+  boolean cFound=false;
   boolean twFail=false;
-  
-  while(char *t1=strtok_r(buf,"{",&p1)){           // parse 'buf' and extract objects into 'pObj' unless NULL
-   buf=NULL;
-    char *p2;
-    int okay=0;
+  char *key;
+  char *val;
+
+  if(!json.expect('{'))
+    return(json.error("expected opening '{'"));
+
+  do {                                                                      // parse top-level properties
     
-    while(char *t2=strtok_r(t1,"}[]:, \"\t\n\r",&p2)){
+    if(!(key=json.string()) || !json.expect(':'))
+      return(json.error("expected property name"));
 
-      if(!cFound){                                 // first token found
-        if(strcmp(t2,"characteristics")){
-          Serial.print("\n*** ERROR:  Problems parsing JSON - initial \"characteristics\" tag not found\n\n");
-          return(0);
-        }
-        cFound=1;
-        break;
+    if(!strcmp(key,"characteristics")){
+
+      if(!json.expect('['))
+        return(json.error("expected '[' following \"characteristics\""));
+
+      if(json.peek()!=']'){
+        do {                                                                // parse characteristic objects
+          
+          if(nObj==maxObj || !json.expect('{'))
+            return(json.error("expected characteristic object"));
+          
+          int okay=0;
+          
+          do {                                                              // parse properties of characteristic object
+            
+            if(!(key=json.string()) || !json.expect(':') || !(val=json.value()))
+              return(json.error("malformed characteristic property"));
+
+            if(!strcmp(key,"aid")){
+              pObj[nObj].aid=strtoul(val,NULL,10);
+              okay|=1;
+            } else
+            if(!strcmp(key,"iid")){
+              pObj[nObj].iid=atoi(val);
+              okay|=2;
+            } else
+            if(!strcmp(key,"value")){
+              pObj[nObj].val=val;
+              okay|=4;
+            } else
+            if(!strcmp(key,"ev")){
+              pObj[nObj].ev=val;
+              okay|=8;
+            } else {
+              Serial.print("\n*** ERROR:  Problems parsing JSON characteristics object - unexpected property \"");
+              Serial.print(key);
+              Serial.print("\"\n\n");
+              return(0);
+            }
+            
+          } while(json.expect(','));
+
+          if(!json.expect('}'))
+            return(json.error("expected closing '}' of characteristic object"));
+          
+          if(okay!=7 && okay!=11 && okay!=15){                              // required properties not found
+            Serial.print("\n*** ERROR:  Problems parsing JSON characteristics object - missing required properties\n\n");
+            return(0);
+          }
+
+          nObj++;
+          
+        } while(json.expect(','));
       }
+
+      if(!json.expect(']'))
+        return(json.error("expected closing ']' of \"characteristics\""));
+        
+      cFound=true;
       
-      t1=NULL;
-      char *t3;
-      if(!strcmp(t2,"aid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        sscanf(t3,"%u",&pObj[nObj].aid);
-        okay|=1;
-      } else 
-      if(!strcmp(t2,"iid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        pObj[nObj].iid=atoi(t3);
-        okay|=2;
-      } else 
-      if(!strcmp(t2,"value") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        pObj[nObj].val=t3;
-        okay|=4;
-      } else 
-      if(!strcmp(t2,"ev") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        pObj[nObj].ev=t3;
-        okay|=8;
-      } else 
-      if(!strcmp(t2,"pid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){        
-        uint64_t pid=strtoull(t3,NULL,0);        
-        if(!TimedWrites.count(pid)){
-          Serial.print("\n*** ERROR:  Timed Write PID not found\n\n");
-          twFail=true;
-        } else        
-        if(millis()>TimedWrites[pid]){
-          Serial.print("\n*** ERROR:  Timed Write Expired\n\n");
-          twFail=true;
-        }        
-      } else {
-        Serial.print("\n*** ERROR:  Problems parsing JSON characteristics object - unexpected property \"");
-        Serial.print(t2);
-        Serial.print("\"\n\n");
-        return(0);
-      }
-    } // parse property tokens
+    } else 
+    
+    if(!strcmp(key,"pid")){
 
-    if(!t1){                                                                  // at least one token was found that was not initial "characteristics"
-      if(okay==7 || okay==11  || okay==15){                                   // all required properties found                           
-        nObj++;                                                               // increment number of characteristic objects found        
-      } else {
-        Serial.print("\n*** ERROR:  Problems parsing JSON characteristics object - missing required properties\n\n");
-        return(0);
+      if(!(val=json.value()))
+        return(json.error("malformed \"pid\""));
+        
+      uint64_t pid=strtoull(val,NULL,0);        
+      if(!TimedWrites.count(pid)){
+        Serial.print("\n*** ERROR:  Timed Write PID not found\n\n");
+        twFail=true;
+      } else        
+      if(millis()>TimedWrites[pid]){
+        Serial.print("\n*** ERROR:  Timed Write Expired\n\n");
+        twFail=true;
       }
+              
+    } else {
+      Serial.print("\n*** ERROR:  Problems parsing JSON - unexpected property \"");
+      Serial.print(key);
+      Serial.print("\"\n\n");
+      return(0);
     }
-      
-  } // parse objects
+    
+  } while(json.expect(','));
+
+  if(!json.expect('}'))
+    return(json.error("expected closing '}'"));
+
+  if(!cFound){
+    Serial.print("\n*** ERROR:  Problems parsing JSON - initial \"characteristics\" tag not found\n\n");
+    return(0);
+  }
 
   snapTime=millis();                                           // timestamp for this series of updates, assigned to each characteristic in loadUpdate()
 
@@ -934,17 +1259,39 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
     } // object had TBD status
   } // loop over all objects
       
-  return(1);
+  return(nObj);
 }
 
 ///////////////////////////////
 
 void Span::clearNotify(int slotNum){
   
-  for(int i=0;i<Accessories.size();i++){
-    for(int j=0;j<Accessories[i]->Services.size();j++){
-      for(int k=0;k<Accessories[i]->Services[j]->Characteristics.size();k++){
-        Accessories[i]->Services[j]->Characteristics[k]->ev[slotNum]=false;
+  memset(evTable+slotNum*evWords,0,evWords*sizeof(uint32_t));         // clear entire bitset row for this connection
+  hap[slotNum]->subscriptions.clear();                                // clear list of subscribed Characteristics for this connection
+}
+
+///////////////////////////////
+
+void Span::setEv(SpanCharacteristic *c, int slotNum, boolean evFlag){
+
+  uint32_t *w=evTable+slotNum*evWords+(c->evIndex>>5);
+  uint32_t mask=1UL<<(c->evIndex&31);
+
+  if(evFlag==((*w&mask)!=0))                            // no change in subscription
+    return;
+
+  vector<SpanCharacteristic *> &subs=hap[slotNum]->subscriptions;
+  
+  if(evFlag){
+    *w|=mask;
+    subs.push_back(c);
+  } else {
+    *w&=~mask;
+    for(int i=0;i<subs.size();i++){                     // order does not matter, so remove by swapping with last element
+      if(subs[i]==c){
+        subs[i]=subs.back();
+        subs.pop_back();
+        break;
       }
     }
   }
@@ -952,58 +1299,64 @@ void Span::clearNotify(int slotNum){
 
 ///////////////////////////////
 
-int Span::sprintfNotify(SpanBuf *pObj, int nObj, char *cBuf, int conNum){
+void Span::writeFragments(SpanBuf *pObj, int nObj, JsonWriter &frags, int *offset){
+
+  for(int i=0;i<nObj;i++){                              // loop over all objects
+    
+    offset[i]=frags.len;                                // start of fragment for object i
+    
+    if(pObj[i].status==StatusCode::OK && pObj[i].val)             // characteristic was successfully updated with a new value (i.e. not just an EV request)
+      pObj[i].characteristic->writeAttributes(frags,GET_AID+GET_NV);   // write JSON attributes for characteristic (once, regardless of number of subscribed connections)
+  }
+
+  offset[nObj]=frags.len;                               // end of last fragment
+}
+
+///////////////////////////////
+
+boolean Span::writeNotify(SpanBuf *pObj, int nObj, JsonWriter &frags, int *offset, JsonWriter &json, int conNum){
 
-  int nChars=0;
   boolean notifyFlag=false;
   
-  nChars+=snprintf(cBuf,cBuf?64:0,"{\"characteristics\":[");
-
   for(int i=0;i<nObj;i++){                              // loop over all objects
     
-    if(pObj[i].status==StatusCode::OK && pObj[i].val){           // characteristic was successfully updated with a new value (i.e. not just an EV request)
+    int fLen=offset[i+1]-offset[i];
+    
+    if(fLen && getEv(conNum,pObj[i].characteristic->evIndex)){    // if object has a rendered fragment and notifications requested for this characteristic by specified connection number
       
-      if(pObj[i].characteristic->ev[conNum]){           // if notifications requested for this characteristic by specified connection number
+      json.add(notifyFlag?",":"{\"characteristics\":[");   // add opening text before first fragment, or preceeding comma before subsequent fragments
+      json.add(frags.buf+offset[i],fLen);              // copy pre-rendered fragment
+      notifyFlag=true;
       
-        if(notifyFlag)                                                           // already printed at least one other characteristic
-          nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,",");               // add preceeding comma before printing next characteristic
-        
-        nChars+=pObj[i].characteristic->sprintfAttributes(cBuf?(cBuf+nChars):NULL,GET_AID+GET_NV);    // get JSON attributes for characteristic
-        notifyFlag=true;
-        
-      } // notification requested
-    } // characteristic updated
+    } // notification requested
   } // loop over all objects
 
-  nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,"]}");
+  if(!notifyFlag)                                       // nothing to notify
+    return(false);
 
-  return(notifyFlag?nChars:0);                          // if notifyFlag is not set, return 0, else return number of characters printed to cBuf
+  json.add("]}");
+  return(true);
 }
 
 ///////////////////////////////
 
-int Span::sprintfAttributes(SpanBuf *pObj, int nObj, char *cBuf){
-
-  int nChars=0;
+void Span::writeAttributes(SpanBuf *pObj, int nObj, JsonWriter &json){
 
-  nChars+=snprintf(cBuf,cBuf?64:0,"{\"characteristics\":[");
+  json.add("{\"characteristics\":[");
 
   for(int i=0;i<nObj;i++){
-      nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?128:0,"{\"aid\":%u,\"iid\":%d,\"status\":%d}",pObj[i].aid,pObj[i].iid,pObj[i].status);
-      if(i+1<nObj)
-        nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,",");
+    if(i>0)
+      json.add(',');
+    json.add("{\"aid\":").addUInt(pObj[i].aid).add(",\"iid\":").addInt(pObj[i].iid).add(",\"status\":").addInt((int)pObj[i].status).add('}');
   }
 
-  nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,"]}");
-
-  return(nChars);    
+  json.add("]}");
 }
 
 ///////////////////////////////
 
-int Span::sprintfAttributes(char **ids, int numIDs, int flags, char *cBuf){
+boolean Span::writeAttributes(char **ids, int numIDs, int flags, JsonWriter &json){
 
-  int nChars=0;
   uint32_t aid;
   int iid;
   
@@ -1029,30 +1382,83 @@ int Span::sprintfAttributes(char **ids, int numIDs, int flags, char *cBuf){
     }
   }
 
-  nChars+=snprintf(cBuf,cBuf?64:0,"{\"characteristics\":[");  
+  json.add("{\"characteristics\":[");  
 
   for(int i=0;i<numIDs;i++){              // PASS 2: loop over all ids requested and create JSON for each (with or without status code base on sFlag set above)
+
+    if(i>0)
+      json.add(',');
     
     if(Characteristics[i])                                                                         // if found
-      nChars+=Characteristics[i]->sprintfAttributes(cBuf?(cBuf+nChars):NULL,flags);                // get JSON attributes for characteristic
+      Characteristics[i]->writeAttributes(json,flags);                                             // write JSON attributes for characteristic
     else{
       sscanf(ids[i],"%u.%d",&aid,&iid);     // parse aid and iid                        
-      nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,"{\"iid\":%d,\"aid\":%u}",iid,aid);      // else create JSON attributes based on requested aid/iid
+      json.add("{\"iid\":").addInt(iid).add(",\"aid\":").addUInt(aid).add('}');                // else create JSON attributes based on requested aid/iid
     }
     
     if(sFlag){                                                                                    // status flag is needed - overlay at end
-      nChars--;
-      nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,",\"status\":%d}",status[i]);
+      json.trim(1);
+      json.add(",\"status\":").addInt((int)status[i]).add('}');
     }
-  
-    if(i+1<numIDs)
-      nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,",");
-    
   }
 
-  nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,"]}");
+  json.add("]}");
+
+  return(sFlag);    
+}
+
+///////////////////////////////
+//        SpanStats          //
+///////////////////////////////
+
+void SpanStats::tally(uint64_t &total, uint32_t &maxTime, unsigned long startTime){
 
-  return(nChars);    
+  uint32_t elapsed=micros()-startTime;
+  total+=elapsed;
+  if(elapsed>maxTime)
+    maxTime=elapsed;
+}
+
+///////////////////////////////
+
+void SpanStats::print(){
+
+  char cBuf[128];
+  
+  Serial.print("\n*** HomeSpan Timing Statistics ***\n\n");
+
+  sprintf(cBuf,"Elapsed Time: %lu sec\n\n",(millis()-resetTime)/1000);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10s  %14s  %10s  %10s\n","Phase","Count","Total (ms)","Avg (us)","Max (us)");
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10s  %14s  %10s  %10s\n","----------------------","----------","--------------","----------","----------");
+  Serial.print(cBuf);
+  
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","poll()",nPolls,pollTime/1000,nPolls?pollTime/nPolls:0,maxPollTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","Idle poll()",nIdlePolls,idleTime/1000,nIdlePolls?idleTime/nIdlePolls:0,maxIdleTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","HAP Requests",nRequests,requestTime/1000,nRequests?requestTime/nRequests:0,maxRequestTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","Service Loops/Buttons",nPolls,loopTime/1000,nPolls?loopTime/nPolls:0,maxLoopTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","Event Notifications",nPolls,notifyTime/1000,nPolls?notifyTime/nPolls:0,maxNotifyTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","Pair-Verify (full)",nVerify,verifyTime/1000,nVerify?verifyTime/nVerify:0,maxVerifyTime);
+  Serial.print(cBuf);
+  sprintf(cBuf,"%-22s  %10u  %14llu  %10llu  %10u\n","Pair-Resume",nResumes,resumeTime/1000,nResumes?resumeTime/nResumes:0,maxResumeTime);
+  Serial.print(cBuf);
+
+  if(nResumes+nResumeMisses){
+    sprintf(cBuf,"\nPair-Resume Hit Rate: %u of %u (%u%%)\n",nResumes,nResumes+nResumeMisses,nResumes*100/(nResumes+nResumeMisses));
+    Serial.print(cBuf);
+    if(nVerify && nResumes){
+      sprintf(cBuf,"Time Saved per Resume: %lld us\n",(long long)(verifyTime/nVerify)-(long long)(resumeTime/nResumes));
+      Serial.print(cBuf);
+    }
+  }
+
+  Serial.print("\n*** End Statistics ***\n\n");
 }
 
 ///////////////////////////////
@@ -1128,20 +1534,17 @@ void SpanAccessory::validate(){
 
 ///////////////////////////////
 
-int SpanAccessory::sprintfAttributes(char *cBuf){
-  int nBytes=0;
+void SpanAccessory::writeAttributes(JsonWriter &json){
 
-  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"aid\":%u,\"services\":[",aid);
+  json.add("{\"aid\":").addUInt(aid).add(",\"services\":[");
 
   for(int i=0;i<Services.size();i++){
-    nBytes+=Services[i]->sprintfAttributes(cBuf?(cBuf+nBytes):NULL);    
-    if(i+1<Services.size())
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",");
-    }
+    if(i>0)
+      json.add(',');
+    Services[i]->writeAttributes(json);    
+  }
     
-  nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"]}");
-
-  return(nBytes);
+  json.add("]}");
 }
 
 ///////////////////////////////
@@ -1194,28 +1597,25 @@ SpanService *SpanService::setHidden(){
 
 ///////////////////////////////
 
-int SpanService::sprintfAttributes(char *cBuf){
-  int nBytes=0;
+void SpanService::writeAttributes(JsonWriter &json){
 
-  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"iid\":%d,\"type\":\"%s\",",iid,type);
+  json.add("{\"iid\":").addInt(iid).add(",\"type\":").addString(type).add(',');
   
   if(hidden)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"\"hidden\":true,");
+    json.add("\"hidden\":true,");
     
   if(primary)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"\"primary\":true,");
+    json.add("\"primary\":true,");
     
-  nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"\"characteristics\":[");
+  json.add("\"characteristics\":[");
   
   for(int i=0;i<Characteristics.size();i++){
-    nBytes+=Characteristics[i]->sprintfAttributes(cBuf?(cBuf+nBytes):NULL,GET_META|GET_PERMS|GET_TYPE|GET_DESC);    
-    if(i+1<Characteristics.size())
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",");
+    if(i>0)
+      json.add(',');
+    Characteristics[i]->writeAttributes(json,GET_META|GET_PERMS|GET_TYPE|GET_DESC);    
   }
     
-  nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"]}");
-
-  return(nBytes);
+  json.add("]}");
 }
 
 ///////////////////////////////
@@ -1256,7 +1656,7 @@ SpanCharacteristic::SpanCharacteristic(const char *type, uint8_t perms, const ch
   service=homeSpan.Accessories.back()->Services.back();
   aid=homeSpan.Accessories.back()->aid;
 
-  ev=(boolean *)calloc(homeSpan.maxConnections,sizeof(boolean));
+  evIndex=homeSpan.nCharacteristics++;
 
   homeSpan.configLog+="-" + String(iid) + String(" (") + String(type) + String(") ");
 
@@ -1347,93 +1747,102 @@ SpanCharacteristic::SpanCharacteristic(const char *type, uint8_t perms, const ch
 
 ///////////////////////////////
 
-int SpanCharacteristic::sprintfAttributes(char *cBuf, int flags){
-  int nBytes=0;
+void SpanCharacteristic::writeAttributes(JsonWriter &json, int flags){
 
   const char permCodes[][7]={"pr","pw","ev","aa","tw","hd","wr"};
 
   const char formatCodes[][8]={"bool","uint8","uint16","uint32","uint64","int","float","string"};
 
-  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"iid\":%d",iid);
+  json.add("{\"iid\":").addInt(iid);
 
   if(flags&GET_TYPE)  
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"type\":\"%s\"",type);
+    json.add(",\"type\":").addString(type);
 
   if(perms&PR){
-    
-    if(perms&NV && !(flags&GET_NV)){   
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":null");
-    } else {
-      
-      switch(format){
-        case BOOL:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%s",value.BOOL?"true":"false");
-        break;
-    
-        case INT:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%d",value.INT);
-        break;
-    
-        case UINT8:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%u",value.UINT8);
-        break;
-          
-        case UINT16:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%u",value.UINT16);
-        break;
-          
-        case UINT32:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%lu",value.UINT32);
-        break;
-          
-        case UINT64:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%llu",value.UINT64);
-        break;
-          
-        case FLOAT:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%lg",value.FLOAT);
-        break;
-          
-        case STRING:
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":\"%s\"",value.STRING);
-        break;
-        
-      } // switch
-    } // print Characteristic value
-  } // permissions=PR
+    json.add(",\"value\":");
+
+    if(homeSpan.attributeCache.building)                          // creating attributeCache skeleton - record where value is to be inserted instead of writing it
+      homeSpan.attributeCache.slots.push_back({json.len,this});
+    else
+      writeValue(json,flags);
+  }
 
   if(flags&GET_META){
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"format\":\"%s\"",formatCodes[format]);
+    json.add(",\"format\":\"").add(formatCodes[format]).add('"');
     
-    if(range && (flags&GET_META))
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"minValue\":%d,\"maxValue\":%d,\"minStep\":%d",range->min,range->max,range->step);    
+    if(range)
+      json.add(",\"minValue\":").addInt(range->min).add(",\"maxValue\":").addInt(range->max).add(",\"minStep\":").addInt(range->step);
   }
     
-  if(desc && (flags&GET_DESC)){
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"description\":\"%s\"",desc);    
-  }
+  if(desc && (flags&GET_DESC))
+    json.add(",\"description\":").addString(desc);
 
   if(flags&GET_PERMS){
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"perms\":[");
+    json.add(",\"perms\":[");
+    boolean first=true;
     for(int i=0;i<7;i++){
       if(perms&(1<<i)){
-        nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"\"%s\"",permCodes[i]);
-        if(perms>=(1<<(i+1)))
-          nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",");
+        if(!first)
+          json.add(',');
+        json.add('"').add(permCodes[i]).add('"');
+        first=false;
       }
     }
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"]");
+    json.add(']');
   }
 
   if(flags&GET_AID)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"aid\":%u",aid);
+    json.add(",\"aid\":").addUInt(aid);
   
   if(flags&GET_EV)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"ev\":%s",ev[HAPClient::conNum]?"true":"false");
+    json.add(",\"ev\":").addBool(homeSpan.getEv(HAPClient::conNum,evIndex));
+
+  json.add('}');
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::writeValue(JsonWriter &json, int flags){
+
+  if(perms&NV && !(flags&GET_NV)){   
+    json.add("null");
+    return;
+  }
+    
+  switch(format){
+    case BOOL:
+      json.addBool(value.BOOL);
+    break;
 
-  nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"}");
+    case INT:
+      json.addInt(value.INT);
+    break;
 
-  return(nBytes);
+    case UINT8:
+      json.addUInt(value.UINT8);
+    break;
+      
+    case UINT16:
+      json.addUInt(value.UINT16);
+    break;
+      
+    case UINT32:
+      json.addUInt(value.UINT32);
+    break;
+      
+    case UINT64:
+      json.addUInt(value.UINT64);
+    break;
+      
+    case FLOAT:
+      json.addFloat(value.FLOAT);
+    break;
+      
+    case STRING:
+      json.addString(value.STRING);
+    break;
+    
+  } // switch
 }
 
 ///////////////////////////////
@@ -1443,11 +1852,7 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
   if(ev){                // request for notification
     boolean evFlag;
     
-    if(!strcmp(ev,"0") || !strcmp(ev,"false"))
-      evFlag=false;
-    else if(!strcmp(ev,"1") || !strcmp(ev,"true"))
-      evFlag=true;
-    else
+    if(!JsonReader::toBool(ev,evFlag))
       return(StatusCode::InvalidValue);
     
     if(evFlag && !(perms&EV))         // notification is not supported for characteristic
@@ -1460,7 +1865,7 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
     LOG1(": ");
     LOG1(evFlag?"true":"false");
     LOG1("\n");
-    this->ev[HAPClient::conNum]=evFlag;
+    homeSpan.setEv(this,HAPClient::conNum,evFlag);
   }
 
   if(!val)                // no request to update value
@@ -1469,49 +1874,73 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
   if(!(perms&PW))         // cannot write to read only characteristic
     return(StatusCode::ReadOnly);
 
-  switch(format){
+  UVal v=newValue;        // parsed value - only saved to newValue once it has been fully validated
+  double d=0;             // parsed value as a double, used to check against range
+  int64_t n;
+  uint64_t u;
+
+  switch(format){         // parse according to format, and check against limits of format (HAP Table 6-5)
     
     case BOOL:
-      if(!strcmp(val,"0") || !strcmp(val,"false"))
-        newValue.BOOL=false;
-      else if(!strcmp(val,"1") || !strcmp(val,"true"))
-        newValue.BOOL=true;
-      else
+      if(!JsonReader::toBool(val,v.BOOL))
         return(StatusCode::InvalidValue);
+      d=v.BOOL;
       break;
 
     case INT:
-      if(!sscanf(val,"%d",&newValue.INT))
+      if(!JsonReader::toInt(val,n) || n<INT32_MIN || n>INT32_MAX)
         return(StatusCode::InvalidValue);
+      d=v.INT=n;
       break;
 
     case UINT8:
-      if(!sscanf(val,"%u",&newValue.UINT8))
+      if(!JsonReader::toUInt(val,u) || u>UINT8_MAX)
         return(StatusCode::InvalidValue);
+      d=v.UINT8=u;
       break;
             
     case UINT16:
-      if(!sscanf(val,"%u",&newValue.UINT16))
+      if(!JsonReader::toUInt(val,u) || u>UINT16_MAX)
         return(StatusCode::InvalidValue);
+      d=v.UINT16=u;
       break;
       
     case UINT32:
-      if(!sscanf(val,"%llu",&newValue.UINT32))
+      if(!JsonReader::toUInt(val,u) || u>UINT32_MAX)
         return(StatusCode::InvalidValue);
+      d=v.UINT32=u;
       break;
       
     case UINT64:
-      if(!sscanf(val,"%llu",&newValue.UINT64))
+      if(!JsonReader::toUInt(val,v.UINT64))
         return(StatusCode::InvalidValue);
+      d=v.UINT64;
       break;
 
     case FLOAT:
-      if(!sscanf(val,"%lg",&newValue.FLOAT))
+      if(!JsonReader::toFloat(val,v.FLOAT))
         return(StatusCode::InvalidValue);
+      d=v.FLOAT;
+      break;
+
+    case STRING:
       break;
 
   } // switch
 
+  if(range && format!=BOOL && format!=STRING){              // check value against min/max/step specified with SpanRange
+
+    if(d<range->min || d>range->max)
+      return(StatusCode::InvalidValue);
+
+    if(range->step>0){
+      double nSteps=(d-range->min)/range->step;
+      if(fabs(nSteps-round(nSteps))>1e-6)                     // value must be a multiple of step above min (allowing for FLOAT rounding)
+        return(StatusCode::InvalidValue);
+    }
+  }
+
+  newValue=v;
   isUpdated=true;
   updateTime=homeSpan.snapTime;
   return(StatusCode::TBD);
@@ -1521,34 +1950,47 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
 
 void SpanCharacteristic::setVal(int val){
 
+    SpanSetVal sv={this,false,val,0};
+    
+    if(homeSpan.deferSetVal(sv))            // called from sketch's task while autoPoll() is running - polling task will apply value
+      return;
+
+    boolean changed=false;                  // flag indicating whether new value differs from current value
+    
     switch(format){
       
       case BOOL:
+        changed=(value.BOOL!=(boolean)val);
         value.BOOL=(boolean)val;
         newValue.BOOL=(boolean)val;        
       break;
 
       case INT:
+        changed=(value.INT!=(int)val);
         value.INT=(int)val;
         newValue.INT=(int)val;
       break;
 
       case UINT8:
+        changed=(value.UINT8!=(uint8_t)val);
         value.UINT8=(uint8_t)val;
-        newValue.INT=(int)val;
+        newValue.UINT8=(uint8_t)val;
       break;
 
       case UINT16:
+        changed=(value.UINT16!=(uint16_t)val);
         value.UINT16=(uint16_t)val;
         newValue.UINT16=(uint16_t)val;
       break;
 
       case UINT32:
+        changed=(value.UINT32!=(uint32_t)val);
         value.UINT32=(uint32_t)val;
         newValue.UINT32=(uint32_t)val;
       break;
 
       case UINT64:
+        changed=(value.UINT64!=(uint64_t)val);
         value.UINT64=(uint64_t)val;
         newValue.UINT64=(uint64_t)val;
       break;
@@ -1556,28 +1998,51 @@ void SpanCharacteristic::setVal(int val){
 
     updateTime=homeSpan.snapTime;
 
-    SpanBuf sb;                             // create SpanBuf object
-    sb.characteristic=this;                 // set characteristic          
-    sb.status=StatusCode::OK;               // set status
-    char dummy[]="";
-    sb.val=dummy;                           // set dummy "val" so that sprintfNotify knows to consider this "update"
-    homeSpan.Notifications.push_back(sb);   // store SpanBuf in Notifications vector
+    if(changed || (perms&NV))               // unchanged values are not re-notified, except for NV Characteristics (such as ProgrammableSwitchEvent) where every call to setVal() is an event
+      queueNotify();
 }
 
 ///////////////////////////////
 
 void SpanCharacteristic::setVal(double val){
+
+    SpanSetVal sv={this,true,0,val};
+    
+    if(homeSpan.deferSetVal(sv))            // called from sketch's task while autoPoll() is running - polling task will apply value
+      return;
+
+    boolean changed=(value.FLOAT!=val);
   
     value.FLOAT=(double)val;  
     newValue.FLOAT=(double)val;  
     updateTime=homeSpan.snapTime;
 
-    SpanBuf sb;                             // create SpanBuf object
-    sb.characteristic=this;                 // set characteristic          
-    sb.status=StatusCode::OK;               // set status
-    char dummy[]="";
-    sb.val=dummy;                           // set dummy "val" so that sprintfNotify knows to consider this "update"
-    homeSpan.Notifications.push_back(sb);   // store SpanBuf in Notifications vector
+    if(changed || (perms&NV))               // unchanged values are not re-notified, except for NV Characteristics
+      queueNotify();
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::queueNotify(){
+
+  if(notifyPending)                       // already in Notifications vector - latest value will be sent when notification goes out
+    return;
+
+  static char dummy[]="";
+  
+  SpanBuf sb;                             // create SpanBuf object
+  sb.characteristic=this;                 // set characteristic          
+  sb.status=StatusCode::OK;               // set status
+  sb.val=dummy;                           // set dummy "val" so that writeNotify knows to consider this "update"
+  homeSpan.Notifications.push_back(sb);   // store SpanBuf in Notifications vector
+  notifyPending=true;
+}
+
+///////////////////////////////
+
+SpanCharacteristic *SpanCharacteristic::setNotifyInterval(uint32_t ms){
+  notifyInterval=ms;
+  return(this);
 }
 
 ///////////////////////////////
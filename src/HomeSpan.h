@@ -27,17 +27,19 @@
  
 #pragma once
 
-#ifndef ARDUINO_ARCH_ESP32
+#if !defined(ARDUINO_ARCH_ESP32) && !defined(HOMESPAN_HOST)        // HOMESPAN_HOST is defined by the Linux host build (see host/CMakeLists.txt)
 #error ERROR: HOMESPAN IS ONLY AVAILABLE FOR ESP32 MICROCONTROLLERS!
 #endif
 
 #include <Arduino.h>
 #include <unordered_map>
+#include <atomic>
 
 #include "Settings.h"
 #include "Utils.h"
 #include "Network.h"
 #include "HAPConstants.h"
+#include "JSON.h"
 
 using std::vector;
 using std::unordered_map;
@@ -72,6 +74,59 @@ struct SpanConfig {
 
 ///////////////////////////////
 
+struct SpanStats {
+  uint32_t nPolls=0;                          // number of calls to poll() since statistics were last reset
+  uint32_t nRequests=0;                       // number of HAP requests processed since statistics were last reset
+  uint32_t nIdlePolls=0;                      // number of calls to poll() that found no new clients and no readable sockets
+  uint64_t pollTime=0;                        // cumulative time (in micros) spent in poll()
+  uint64_t idleTime=0;                        // cumulative time (in micros) spent in idle calls to poll()
+  uint64_t requestTime=0;                     // cumulative time (in micros) spent processing HAP requests
+  uint64_t loopTime=0;                        // cumulative time (in micros) spent in user-defined Service loops(), including PushButton checks
+  uint64_t notifyTime=0;                      // cumulative time (in micros) spent sending Event Notifications
+  uint32_t maxPollTime=0;                     // longest single call to poll() (in micros)
+  uint32_t maxIdleTime=0;                     // longest single idle call to poll() (in micros)
+  uint32_t maxRequestTime=0;                  // longest single HAP request (in micros)
+  uint32_t maxLoopTime=0;                     // longest single pass through user-defined Service loops() (in micros)
+  uint32_t maxNotifyTime=0;                   // longest single pass through Event Notifications (in micros)
+  uint32_t nVerify=0;                         // number of full Pair-Verify exchanges completed
+  uint32_t nResumes=0;                        // number of sessions resumed with Pair-Resume (cache hits)
+  uint32_t nResumeMisses=0;                   // number of Pair-Resume requests that required a full Pair-Verify (cache misses)
+  uint64_t verifyTime=0;                      // cumulative time (in micros) spent computing full Pair-Verify exchanges
+  uint64_t resumeTime=0;                      // cumulative time (in micros) spent computing Pair-Resume exchanges
+  uint32_t maxVerifyTime=0;                   // longest single Pair-Verify <M3> request (in micros)
+  uint32_t maxResumeTime=0;                   // longest single Pair-Resume request (in micros)
+  unsigned long resetTime=0;                  // time (in millis) statistics were last reset
+
+  void reset(){*this=SpanStats();resetTime=millis();}        // resets all statistics
+  void tally(uint64_t &total, uint32_t &maxTime, unsigned long startTime);     // adds time elapsed since startTime (in micros) to total, and updates maxTime if needed
+  void print();                                              // prints statistics to Serial Monitor
+};
+
+///////////////////////////////
+
+struct SpanSetVal {                           // a call to setVal() made from outside the HAP polling task, queued for the polling task to apply
+  SpanCharacteristic *characteristic;         // Characteristic to update
+  boolean isFloat;                            // true if fVal is to be used, false if iVal is to be used
+  int iVal;                                   // integer value
+  double fVal;                                // floating point value
+};
+
+///////////////////////////////
+
+struct SpanSlot {
+  int offset;                                 // position in cached JSON where the value of a Characteristic is to be inserted
+  SpanCharacteristic *characteristic;         // the Characteristic whose value is to be inserted
+};
+
+struct SpanCache {                            // cached copy of the Attributes JSON database, with all Characteristic values left out, used to speed up GET /accessories
+  char *json=NULL;                            // JSON database skeleton (NULL = not yet created)
+  int len=0;                                  // length of JSON database skeleton, excluding null terminator
+  vector<SpanSlot> slots;                     // positions in JSON database skeleton where each Characteristic value needs to be inserted, in order
+  boolean building=false;                     // flag indicating skeleton is being created - Characteristics record a slot instead of printing their values
+};
+
+///////////////////////////////
+
 struct Span{
 
   const char *displayName;                      // display name for this device - broadcast as part of Bonjour MDNS
@@ -80,7 +135,7 @@ struct Span{
   const char *modelName;                        // model name of this device - broadcast as Bonjour field "md" 
   char category[3]="";                          // category ID of primary accessory - broadcast as Bonjour field "ci" (HAP Section 13)
   unsigned long snapTime;                       // current time (in millis) snapped before entering Service loops() or updates()
-  boolean isInitialized=false;                  // flag indicating HomeSpan has been initialized
+  std::atomic<boolean> isInitialized{false};    // flag indicating HomeSpan has been initialized (read by the sketch's task while autoPoll() is running)
   int nFatalErrors=0;                           // number of fatal errors in user-defined configuration
   String configLog;                             // log of configuration process, including any errors
   boolean isBridge=true;                        // flag indicating whether device is configured as a bridge (i.e. first Accessory contains nothing but AccessoryInformation and HAPProtocolInformation)
@@ -96,12 +151,20 @@ struct Span{
   PushButton controlButton;                         // controls HomeSpan configuration and resets
   Network network;                                  // configures WiFi and Setup Code via either serial monitor or temporary Access Point
     
+  SpanCache attributeCache;                         // cached skeleton of Attributes JSON database
+  SpanStats stats;                                  // timing statistics for poll() and its main phases - printed and reset with 't' command
   SpanConfig hapConfig;                             // track configuration changes to the HAP Accessory database; used to increment the configuration number (c#) when changes found
   vector<SpanAccessory *> Accessories;              // vector of pointers to all Accessories
   vector<SpanService *> Loops;                      // vector of pointer to all Services that have over-ridden loop() methods
   vector<SpanBuf> Notifications;                    // vector of SpanBuf objects that store info for Characteristics that are updated with setVal() and require a Notification Event
   vector<SpanButton *> PushButtons;                 // vector of pointer to all PushButtons
   unordered_map<uint64_t, uint32_t> TimedWrites;    // map of timed-write PIDs and Alarm Times (based on TTLs)
+  unordered_map<uint32_t, SpanAccessory *> aidIndex;    // map of aids to Accessories - created by buildIndex() for use by find()
+  TaskHandle_t pollTaskHandle=NULL;                 // handle to HAP polling task created by autoPoll() (NULL = poll() is called directly from the sketch)
+  SpscQueue<SpanSetVal,32> setValQueue;             // calls to setVal() made from the sketch's task while autoPoll() is running, to be applied by the polling task
+  int nCharacteristics=0;                           // total number of Characteristics instantiated; used to assign each Characteristic its evIndex
+  int evWords=0;                                    // number of 32-bit words in the event notification bitset of each connection
+  uint32_t *evTable=NULL;                           // event notification bitsets, one row of evWords per connection slot, one bit per Characteristic (by evIndex) - created by buildIndex()
 
   HapCharList chr;                                  // list of all HAP Characteristics
 
@@ -111,22 +174,33 @@ struct Span{
              const char *modelName=DEFAULT_MODEL_NAME);        
              
   void poll();                                  // poll HAP Clients and process any new HAP requests
+  void pollServices();                          // calls Service loop() methods and checks PushButtons - always from the sketch's own calls to poll(), even while autoPoll() is running
+  void autoPoll(uint32_t stackSize=8192, uint32_t priority=1, int cpu=0);     // starts a separate task that calls poll() repeatedly, pinned to the specified cpu
+  static void pollTask(void *arg);              // HAP polling task started by autoPoll()
+  boolean deferSetVal(SpanSetVal &sv);          // queues setVal() for the polling task, and returns true, if called from a task other than the polling task while autoPoll() is running; else returns false
   int getFreeSlot();                            // returns free HAPClient slot number. HAPClients slot keep track of each active HAPClient connection
+  int getEvictionSlot(uint32_t passStart);      // returns random HAPClient slot to free for a new connection, excluding slots filled after connection number passStart (-1 if none)
   void initWifi();                              // initialize and connect to WiFi network
   void commandMode();                           // allows user to control and reset HomeSpan settings with the control button
   void processSerialCommand(const char *c);     // process command 'c' (typically from readSerial, though can be called with any 'c')
 
-  int sprintfAttributes(char *cBuf);            // prints Attributes JSON database into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
+  void writeAttributes(JsonWriter &json);       // writes Attributes JSON database into json, using attributeCache
+  void writeDatabase(JsonWriter &json);         // writes full Attributes JSON database into json by formatting every Accessory; used to create attributeCache
+  void buildCache();                            // creates attributeCache skeleton from Attributes JSON database
   void prettyPrint(char *buf, int nsp=2);       // print arbitrary JSON from buf to serial monitor, formatted with indentions of 'nsp' spaces
   SpanCharacteristic *find(uint32_t aid, int iid);   // return Characteristic with matching aid and iid (else NULL if not found)
+  void buildIndex();                                  // creates aidIndex and the iid table of each Accessory so that find() can run in constant time; called once HAP database is complete
   
-  int countCharacteristics(char *buf);                                    // return number of characteristic objects referenced in PUT /characteristics JSON request
-  int updateCharacteristics(char *buf, SpanBuf *pObj);                    // parses PUT /characteristics JSON request 'buf into 'pObj' and updates referenced characteristics; returns 1 on success, 0 on fail
-  int sprintfAttributes(SpanBuf *pObj, int nObj, char *cBuf);             // prints SpanBuf object into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
-  int sprintfAttributes(char **ids, int numIDs, int flags, char *cBuf);   // prints accessory.characteristic ids into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
+  int countCharacteristics(char *buf);                                    // return upper bound on number of characteristic objects referenced in PUT /characteristics JSON request
+  int updateCharacteristics(char *buf, SpanBuf *pObj, int maxObj);        // parses PUT /characteristics JSON request 'buf' in place into at most 'maxObj' 'pObj' and updates referenced characteristics; returns number of objects on success, 0 on fail
+  void writeAttributes(SpanBuf *pObj, int nObj, JsonWriter &json);               // writes status of SpanBuf objects into json
+  boolean writeAttributes(char **ids, int numIDs, int flags, JsonWriter &json);   // writes accessory.characteristic ids into json; returns true if status codes were included because of one or more errors
 
   void clearNotify(int slotNum);                                          // set ev notification flags for connection 'slotNum' to false across all characteristics 
-  int sprintfNotify(SpanBuf *pObj, int nObj, char *cBuf, int conNum);     // prints notification JSON into buf based on SpanBuf objects and specified connection number
+  boolean getEv(int slotNum, int evIndex){return((evTable[slotNum*evWords+(evIndex>>5)]>>(evIndex&31))&1);}       // returns ev notification flag for connection 'slotNum' and Characteristic 'evIndex'
+  void setEv(SpanCharacteristic *c, int slotNum, boolean evFlag);         // sets ev notification flag for connection 'slotNum' and Characteristic 'c', and updates the subscription list of the connection
+  void writeFragments(SpanBuf *pObj, int nObj, JsonWriter &frags, int *offset);   // renders the JSON attributes of each updated SpanBuf object once into frags, recording the start of fragment i in offset[i] and the end of the last in offset[nObj]
+  boolean writeNotify(SpanBuf *pObj, int nObj, JsonWriter &frags, int *offset, JsonWriter &json, int conNum);    // writes notification JSON into json by concatenating the fragments subscribed to by specified connection number; returns false (and writes nothing) if there is nothing to notify
 
   void setControlPin(uint8_t pin){controlPin=pin;}                        // sets Control Pin
   void setStatusPin(uint8_t pin){statusPin=pin;}                          // sets Status Pin
@@ -145,10 +219,11 @@ struct SpanAccessory{
   uint32_t aid=0;                           // Accessory Instance ID (HAP Table 6-1)
   int iidCount=0;                           // running count of iid to use for Services and Characteristics associated with this Accessory                                 
   vector<SpanService *> Services;           // vector of pointers to all Services in this Accessory  
+  vector<SpanCharacteristic *> iidTable;    // table of pointers to Characteristics in this Accessory, indexed by iid (NULL for iids assigned to Services) - created by Span::buildIndex()
 
   SpanAccessory(uint32_t aid=0);
 
-  int sprintfAttributes(char *cBuf);        // prints Accessory JSON database into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL  
+  void writeAttributes(JsonWriter &json);   // writes Accessory JSON database into json
   void validate();                          // error-checks Accessory
 };
 
@@ -170,7 +245,7 @@ struct SpanService{
   SpanService *setPrimary();                              // sets the Service Type to be primary and returns pointer to self
   SpanService *setHidden();                               // sets the Service Type to be hidden and returns pointer to self
 
-  int sprintfAttributes(char *cBuf);                      // prints Service JSON records into buf; return number of characters printed, excluding null terminator
+  void writeAttributes(JsonWriter &json);                 // writes Service JSON records into json
   void validate();                                        // error-checks Service
   
   virtual boolean update() {return(true);}                // placeholder for code that is called when a Service is updated via a Controller.  Must return true/false depending on success of update
@@ -223,13 +298,16 @@ struct SpanCharacteristic{
   FORMAT format;                           // Characteristic Format        
   char *desc=NULL;                         // Characteristic Description (optional)
   SpanRange *range=NULL;                   // Characteristic min/max/step; NULL = default values (optional)
-  boolean *ev;                             // Characteristic Event Notify Enable (per-connection)
+  int evIndex;                             // ordinal of this Characteristic in the per-connection event notification bitsets of Span::evTable
   
   uint32_t aid=0;                          // Accessory ID - passed through from Service containing this Characteristic
   boolean isUpdated=false;                 // set to true when new value has been requested by PUT /characteristic
   unsigned long updateTime=0;              // last time value was updated (in millis) either by PUT /characteristic OR by setVal()
   UVal newValue;                           // the updated value requested by PUT /characteristic
   SpanService *service=NULL;               // pointer to Service containing this Characteristic
+  boolean notifyPending=false;             // set to true when Characteristic is queued in Notifications vector, so that repeated calls to setVal() are coalesced into a single Event Notification
+  uint32_t notifyInterval=0;               // minimum time (in millis) between Event Notifications generated by setVal() (0=no limit)
+  unsigned long notifyTime=0;              // time (in millis) of last Event Notification generated by setVal()
       
   SpanCharacteristic(const char *type, uint8_t perms, const char *hapName);
   SpanCharacteristic(const char *type, uint8_t perms, boolean value, const char *hapName);
@@ -241,7 +319,8 @@ struct SpanCharacteristic{
   SpanCharacteristic(const char *type, uint8_t perms, double value, const char *hapName);
   SpanCharacteristic(const char *type, uint8_t perms, const char* value, const char *hapName);
 
-  int sprintfAttributes(char *cBuf, int flags);   // prints Characteristic JSON records into buf, according to flags mask; return number of characters printed, excluding null terminator  
+  void writeAttributes(JsonWriter &json, int flags);    // writes Characteristic JSON records into json, according to flags mask
+  void writeValue(JsonWriter &json, int flags);         // writes JSON value of Characteristic into json (writes null for NV Characteristics, unless GET_NV is set in flags)
   StatusCode loadUpdate(char *val, char *ev);     // load updated val/ev from PUT /characteristic JSON request.  Return intiial HAP status code (checks to see if characteristic is found, is writable, etc.)
   
   template <class T=int> T getVal(){return(getValue<T>(value));}                    // returns UVal value
@@ -250,6 +329,8 @@ struct SpanCharacteristic{
 
   void setVal(int value);                                                           // sets value of UVal value for all integer-based Characterstic types
   void setVal(double value);                                                        // sets value of UVal value for FLOAT Characteristic type
+  void queueNotify();                                                               // queues Characteristic for an Event Notification, unless already queued
+  SpanCharacteristic *setNotifyInterval(uint32_t ms);                               // sets minimum time (in millis) between Event Notifications generated by setVal() and returns pointer to self
 
   boolean updated(){return(isUpdated);}                                             // returns isUpdated
   unsigned long  timeVal();                                                         // returns time elapsed (in millis) since value was last updated
@@ -0,0 +1,441 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+ 
+#include <float.h>
+
+#include "JSON.h"
+
+//////////////////////////////////////
+
+static char noText[1]="";     // buf of a JsonWriter whose initial allocation failed, so that buf is always a valid null-terminated string
+
+//////////////////////////////////////
+
+JsonWriter::JsonWriter(int size){
+  cap=size>0?size:1;
+  buf=(char *)heap_caps_malloc(cap,MALLOC_CAP_8BIT);
+
+  if(!buf){
+    Serial.print("\n*** ERROR: Can't allocate JSON buffer\n\n");
+    buf=noText;
+    cap=1;
+    overflow=true;
+    return;
+  }
+  
+  buf[0]='\0';
+}
+
+//////////////////////////////////////
+
+JsonWriter::~JsonWriter(){
+  if(buf!=noText)
+    heap_caps_free(buf);
+}
+
+//////////////////////////////////////
+
+char *JsonWriter::reserve(int n){
+
+  if(overflow)                          // text is already incomplete - discard everything that follows
+    return(NULL);
+
+  if(len+n+1>cap){                      // not enough room (+1 to leave room for null terminator)
+    int newCap=cap*2;
+    if(newCap<len+n+1)
+      newCap=len+n+1;
+    char *newBuf=(char *)heap_caps_realloc(buf!=noText?buf:NULL,newCap,MALLOC_CAP_8BIT);
+    if(!newBuf){                        // keep existing buffer, which realloc leaves intact on failure
+      Serial.print("\n*** ERROR: Can't grow JSON buffer to ");
+      Serial.print(newCap);
+      Serial.print(" bytes\n\n");
+      overflow=true;
+      return(NULL);
+    }
+    buf=newBuf;
+    cap=newCap;
+  }
+
+  return(buf+len);
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::trim(int n){
+  if(n>len)
+    n=len;
+  len-=n;
+  if(buf!=noText)
+    buf[len]='\0';
+  return(*this);
+}
+
+//////////////////////////////////////
+
+void JsonWriter::clear(){
+  len=0;
+  overflow=false;                       // buffer can be grown again (including one whose initial allocation failed)
+  if(buf!=noText)
+    buf[0]='\0';
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::add(const char *s, int n){
+  char *p=reserve(n);
+  if(!p)
+    return(*this);
+  memcpy(p,s,n);
+  len+=n;
+  buf[len]='\0';
+  return(*this);
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::add(const char *s){
+  return(add(s,strlen(s)));
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::add(char c){
+  if(!reserve(1))
+    return(*this);
+  buf[len++]=c;
+  buf[len]='\0';
+  return(*this);
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::addBool(boolean b){
+  return(b?add("true",4):add("false",5));
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::addInt(int64_t n){
+
+  if(n<0){
+    add('-');
+    return(addUInt((uint64_t)(-(n+1))+1));     // negate without overflowing on the most negative value
+  }
+  
+  return(addUInt(n));
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::addUInt(uint64_t n){
+
+  char digits[20];                 // largest 64-bit unsigned integer requires 20 digits
+  int i=sizeof(digits);
+
+  while(n>0xFFFFFFFF){             // use (slow) 64-bit division only while needed
+    digits[--i]='0'+n%10;
+    n/=10;
+  }
+
+  uint32_t n32=n;                  // finish with 32-bit division, which the ESP32 does in hardware
+  
+  do {
+    digits[--i]='0'+n32%10;
+    n32/=10;
+  } while(n32);
+
+  return(add(digits+i,sizeof(digits)-i));
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::addFloat(double x){
+
+  if(isnan(x) || isinf(x))                          // not representable in JSON
+    return(add("null",4));
+
+  if(fabs(x)<1e15 && x==(double)(int64_t)x)          // integral values are written as integers (range check first, since converting out-of-range values to int64_t is undefined)
+    return(addInt((int64_t)x));
+
+  double ax=fabs(x);                                // below 1e-4, %g below is shorter since it switches to an exponent
+  uint64_t pow10=1;
+
+  for(int d=1;d<=9 && ax>=1e-4;d++){               // find fewest decimal places (up to 9) that reproduce x exactly when read back (scaled and pow10 are exact integers, so scaled/pow10 is the same correctly-rounded double strtod() returns for the decimal text)
+    pow10*=10;
+    double scaled=round(ax*pow10);
+    
+    if(scaled>=9007199254740992.0)                   // beyond 2^53 scaled values are no longer exact integers
+      break;
+      
+    if(scaled/pow10==ax){
+      uint64_t n=scaled;
+      if(x<0)
+        add('-');
+      addUInt(n/pow10);
+      add('.');
+      char frac[9];
+      uint32_t f=n%pow10;
+      for(int i=d-1;i>=0;i--){                      // write fractional part, including leading zeros
+        frac[i]='0'+f%10;
+        f/=10;
+      }
+      return(add(frac,d));
+    }
+  }
+
+  char *p=reserve(24);
+  if(!p)
+    return(*this);
+
+  for(int prec=(ax<DBL_MIN?1:15);prec<=17;prec++){  // fall back on fewest significant digits that reproduce x exactly when read back (17 always do).  Starting at 15 gives the same text as
+                                                    // starting at 1: any decimal of 15 or fewer digits that reads back as a normal x is what %.15g produces (%g drops trailing zeros)
+    int n=sprintf(p,"%.*g",prec,x);
+    if(prec==17 || strtod(p,NULL)==x){
+      len+=n;
+      return(*this);
+    }
+  }
+
+  return(*this);
+}
+
+//////////////////////////////////////
+
+JsonWriter &JsonWriter::addString(const char *s){
+
+  add('"');
+
+  const char *run=s;                  // start of current run of characters that do not need escaping
+
+  for(;*s;s++){
+    if(*s!='"' && *s!='\\' && (uint8_t)*s>=0x20)
+      continue;
+
+    add(run,s-run);                   // flush run of characters up to the one needing escaping
+    run=s+1;
+
+    switch(*s){
+      case '"':  add("\\\"",2); break;
+      case '\\': add("\\\\",2); break;
+      case '\n': add("\\n",2); break;
+      case '\r': add("\\r",2); break;
+      case '\t': add("\\t",2); break;
+      default:
+        if(char *p=reserve(6))
+          len+=sprintf(p,"\\u%04x",*s);
+    }
+  }
+
+  add(run,s-run);
+  return(add('"'));
+}
+
+//////////////////////////////////////
+
+char JsonReader::peek(){
+
+  while(1){
+    char c=saved?saved:*p;
+    if(c!=' ' && c!='\t' && c!='\n' && c!='\r')
+      return(c);
+    saved=0;
+    p++;
+  }
+}
+
+//////////////////////////////////////
+
+boolean JsonReader::expect(char c){
+
+  if(!c || peek()!=c)
+    return(false);
+
+  saved=0;
+  p++;
+  return(true);
+}
+
+//////////////////////////////////////
+
+char *JsonReader::string(){
+
+  if(!expect('"'))
+    return(NULL);
+
+  char *start=p;
+  char *out=p;                        // unescaped characters are written back into buffer, which never runs ahead of the input
+
+  while(*p!='"'){
+
+    if(*p=='\0' || (uint8_t)*p<0x20)   // unterminated string or unescaped control character
+      return(NULL);
+      
+    if(*p!='\\'){
+      *out++=*p++;
+      continue;
+    }
+
+    p++;
+    switch(*p++){
+      case '"':  *out++='"'; break;
+      case '\\': *out++='\\'; break;
+      case '/':  *out++='/'; break;
+      case 'b':  *out++='\b'; break;
+      case 'f':  *out++='\f'; break;
+      case 'n':  *out++='\n'; break;
+      case 'r':  *out++='\r'; break;
+      case 't':  *out++='\t'; break;
+      
+      case 'u': {
+        char hex[5]={0};
+        for(int i=0;i<4;i++){
+          if(!isxdigit(p[i]))
+            return(NULL);
+          hex[i]=p[i];
+        }
+        p+=4;
+        uint16_t code=strtoul(hex,NULL,16);
+        if(code<0x80){                            // encode code point as UTF-8 (takes at most 3 bytes, which is fewer than the 6-byte escape sequence)
+          *out++=code;
+        } else if(code<0x800){
+          *out++=0xC0|(code>>6);
+          *out++=0x80|(code&0x3F);
+        } else {
+          *out++=0xE0|(code>>12);
+          *out++=0x80|((code>>6)&0x3F);
+          *out++=0x80|(code&0x3F);
+        }
+      }
+      break;
+      
+      default:
+        return(NULL);
+    }
+  }
+
+  p++;                // skip closing quote
+  *out='\0';          // null-terminate unescaped string (always at or before position of closing quote)
+  return(start);
+}
+
+//////////////////////////////////////
+
+char *JsonReader::value(){
+
+  char c=peek();
+  
+  if(c=='"')
+    return(string());
+
+  if(!(isalnum(c) || c=='-' || c=='+' || c=='.'))     // not a primitive
+    return(NULL);
+
+  char *start=p;
+
+  while(isalnum(*p) || *p=='-' || *p=='+' || *p=='.')
+    p++;
+
+  saved=*p;           // save character following primitive and overwrite with null terminator
+  *p='\0';
+  return(start);
+}
+
+//////////////////////////////////////
+
+int JsonReader::error(const char *msg){
+
+  Serial.print("\n*** ERROR:  Problems parsing JSON - ");
+  Serial.print(msg);
+  Serial.print("\n\n");
+  return(0);
+}
+
+//////////////////////////////////////
+
+boolean JsonReader::toBool(const char *s, boolean &b){
+
+  if(!strcmp(s,"true") || !strcmp(s,"1"))
+    b=true;
+  else if(!strcmp(s,"false") || !strcmp(s,"0"))
+    b=false;
+  else
+    return(false);
+
+  return(true);
+}
+
+//////////////////////////////////////
+
+boolean JsonReader::toUInt(const char *s, uint64_t &n){
+
+  if(!isdigit(*s))
+    return(false);
+
+  uint64_t v=0;
+  
+  for(;isdigit(*s);s++){
+    uint8_t d=*s-'0';
+    if(v>(UINT64_MAX-d)/10)         // overflow
+      return(false);
+    v=v*10+d;
+  }
+
+  if(*s)                            // trailing characters
+    return(false);
+
+  n=v;
+  return(true);
+}
+
+//////////////////////////////////////
+
+boolean JsonReader::toInt(const char *s, int64_t &n){
+
+  boolean neg=(*s=='-');
+  uint64_t v;
+  
+  if(!toUInt(neg?s+1:s,v) || v>(neg?(uint64_t)INT64_MAX+1:(uint64_t)INT64_MAX))
+    return(false);
+
+  n=neg?(int64_t)(0-v):(int64_t)v;
+  return(true);
+}
+
+//////////////////////////////////////
+
+boolean JsonReader::toFloat(const char *s, double &x){
+
+  char *end;
+  double v=strtod(s,&end);
+
+  if(end==s || *end || isnan(v) || isinf(v))      // not a number, trailing characters, or not finite
+    return(false);
+
+  x=v;
+  return(true);
+}
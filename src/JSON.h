@@ -0,0 +1,98 @@
+/*********************************************************************************
+ *  MIT License
+ *  
+ *  Copyright (c) 2020 Gregg E. Berman
+ *  
+ *  https://github.com/HomeSpan/HomeSpan
+ *  
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *  
+ ********************************************************************************/
+ 
+#pragma once
+
+#include <Arduino.h>
+
+/////////////////////////////////////////////////
+// JSON Writer Structure
+//
+// Appends JSON text into a single heap buffer that
+// grows as needed, so that JSON responses can be
+// created in one pass without first computing their
+// size.  The buffer is always null-terminated.
+//
+// If the buffer cannot be grown, the text written so
+// far is kept, all further text is discarded, and
+// overflow is set.  Callers must check overflow
+// before using the text.
+
+struct JsonWriter {
+
+  char *buf;                  // JSON text written so far (always null-terminated)
+  int len=0;                  // number of characters written, excluding null terminator
+  int cap;                    // allocated size of buf
+  boolean overflow=false;     // set if buf could not be allocated or grown, in which case the text is incomplete
+
+  JsonWriter(int size=256);   // creates writer with initial buffer size of 'size' bytes
+  ~JsonWriter();
+
+  JsonWriter(const JsonWriter &)=delete;                  // writers own their buffer and cannot be copied
+  JsonWriter &operator=(const JsonWriter &)=delete;
+
+  JsonWriter &add(const char *s);             // appends raw (unescaped) text 's'
+  JsonWriter &add(const char *s, int n);      // appends first 'n' characters of raw text 's'
+  JsonWriter &add(char c);                    // appends single raw character 'c'
+  JsonWriter &addBool(boolean b);             // appends true or false
+  JsonWriter &addInt(int64_t n);              // appends signed integer 'n'
+  JsonWriter &addUInt(uint64_t n);            // appends unsigned integer 'n'
+  JsonWriter &addFloat(double x);             // appends floating-point number 'x'
+  JsonWriter &addString(const char *s);       // appends 's' as a quoted JSON string, escaping characters as required
+
+  char *reserve(int n);                       // ensures buf has room for 'n' more characters plus null terminator; returns pointer to end of text (or NULL, and sets overflow, if buf can't be grown)
+  JsonWriter &trim(int n);                    // erases last 'n' characters of text
+  void clear();                               // erases all text and clears overflow (but keeps buffer for re-use)
+};
+
+/////////////////////////////////////////////////
+// JSON Reader Structure
+//
+// Tokenizes a null-terminated JSON buffer in place
+// without allocating any memory.  Strings are unescaped
+// in place, and strings and primitives (numbers, true,
+// false, null) are returned as null-terminated pointers
+// into the original buffer.
+
+struct JsonReader {
+
+  char *p;                    // current position in buffer
+  char saved=0;               // character at current position that was overwritten by a null terminator (0 = none)
+
+  JsonReader(char *buf){p=buf;}
+
+  char peek();                // skips whitespace and returns next character without consuming it ('\0' at end of buffer)
+  boolean expect(char c);     // skips whitespace and consumes next character if it matches 'c'; returns true if matched
+  char *string();             // parses a string in place; returns pointer to null-terminated unescaped string, or NULL if next token is not a valid string
+  char *value();              // parses a string or primitive in place; returns pointer to null-terminated text, or NULL if next token is not a string or primitive
+  int error(const char *msg); // prints parsing error 'msg' and returns 0
+
+  static boolean toBool(const char *s, boolean &b);     // converts primitive 's' (true/false/1/0) into 'b'; returns false if 's' is not a valid boolean
+  static boolean toInt(const char *s, int64_t &n);      // converts primitive 's' into signed integer 'n'; returns false if 's' is not a valid integer or is out of range
+  static boolean toUInt(const char *s, uint64_t &n);    // converts primitive 's' into unsigned integer 'n'; returns false if 's' is not a valid unsigned integer or is out of range
+  static boolean toFloat(const char *s, double &x);     // converts primitive 's' into finite floating-point number 'x'; returns false if 's' is not a valid number
+};
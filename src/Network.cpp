@@ -131,7 +131,7 @@ void Network::apConfigure(){
   }  
 
   WiFiServer apServer(80);
-  client=0;
+  client=WiFiClient();
   
   TempBuffer <uint8_t> tempBuffer(MAX_HTTP+1);
   uint8_t *httpBuf=tempBuffer.buf;
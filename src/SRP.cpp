@@ -59,6 +59,7 @@ SRP6A::SRP6A(){
   mbedtls_mpi_init(&s);
   mbedtls_mpi_init(&x);
   mbedtls_mpi_init(&v);
+  mbedtls_mpi_init(&kv);
   mbedtls_mpi_init(&A);
   mbedtls_mpi_init(&b);
   mbedtls_mpi_init(&B);
@@ -112,7 +113,8 @@ void SRP6A::createVerifyCode(const char *setupCode, uint8_t *verifyCode, uint8_t
   
   mbedtls_mpi_exp_mod(&v,&g,&x,&N,&_rr);                         // create verifier, v (_rr is an internal "helper" structure that mbedtls uses to speed up subsequent exponential calculations)
   mbedtls_mpi_write_binary(&v,verifyCode,384);                   // write v into verifyCode
-  
+
+  createKV();
 }
 
 //////////////////////////////////////
@@ -122,21 +124,49 @@ void SRP6A::loadVerifyCode(uint8_t *verifyCode, uint8_t *salt){
   mbedtls_mpi_read_binary(&s,salt,16);
   mbedtls_mpi_read_binary(&v,verifyCode,384);
 
+  createKV();
+}
+
+//////////////////////////////////////
+
+void SRP6A::createKV(){
+
+  mbedtls_mpi_mul_mpi(&t1,&k,&v);                     // t1 = k*v
+  mbedtls_mpi_mod_mpi(&kv,&t1,&N);                    // kv = t1 %N
+
+  keysReady=false;                                    // any precomputed B was based on prior v
 }
 
 //////////////////////////////////////
 
 void SRP6A::createPublicKey(){
+
+  if(!keysReady)                                      // b and B were not computed ahead of time
+    precomputePublicKey();
+
+  keysReady=false;                                    // b and B are used for only one Pair-Setup attempt
+}
+
+//////////////////////////////////////
+
+void SRP6A::precomputePublicKey(){
     
   getPrivateKey();           // create and load b (random 32 bytes)
-    
+  computePublicKey();
+}
+
+//////////////////////////////////////
+
+void SRP6A::computePublicKey(){
+
   // compute B = kv + g^b %N
   
-  mbedtls_mpi_mul_mpi(&t1,&k,&v);                     // t1 = k*v
-  mbedtls_mpi_exp_mod(&t2,&g,&b,&N,&_rr);             // t2 = g^b %N
-  mbedtls_mpi_add_mpi(&t3,&t1,&t2);                   // t3 = t1 + t2
-  mbedtls_mpi_mod_mpi(&B,&t3,&N);                     // B = t3 %N      = ACCESSORY PUBLIC KEY
+  mbedtls_mpi_exp_mod(&t2,&g,&b,&N,&_rr);             // t2 = g^b %N (first call also initializes _rr, which is then kept for all subsequent calculations)
+  mbedtls_mpi_add_mpi(&B,&kv,&t2);                    // B = kv + t2, where both kv and t2 are already reduced modulo N...
+  if(mbedtls_mpi_cmp_mpi(&B,&N)>=0)                   // ...so at most one subtraction of N is needed, rather than a full division
+    mbedtls_mpi_sub_mpi(&B,&B,&N);                    // B = ACCESSORY PUBLIC KEY
 
+  keysReady=true;
 }
 
 //////////////////////////////////////
@@ -144,7 +174,7 @@ void SRP6A::createPublicKey(){
 void SRP6A::getPrivateKey(){
 
   uint8_t privateKey[32];
-  randombytes_buf(privateKey,16);                     // generate 32 random bytes using libsodium (which uses the ESP32 hardware-based random number generator)
+  randombytes_buf(privateKey,32);                     // generate 32 random bytes using libsodium (which uses the ESP32 hardware-based random number generator)
 
   mbedtls_mpi_read_binary(&b,privateKey,32);
 }
@@ -166,7 +196,8 @@ void SRP6A::createSessionKey(){
   // compute S = (Av^u)^b %N
   
   mbedtls_mpi_exp_mod(&t1,&v,&u,&N,&_rr);         // t1 = v^u %N
-  mbedtls_mpi_mul_mpi(&t2,&A,&t1);                // t2 = A*t1
+  mbedtls_mpi_mul_mpi(&t3,&A,&t1);                // t3 = A*t1
+  mbedtls_mpi_mod_mpi(&t2,&t3,&N);                // t2 = t3 %N, so the base of the next exponentiation is 3072 rather than 6144 bits
   mbedtls_mpi_exp_mod(&S,&t2,&b,&N,&_rr);         // S = t2^b %N
 
   // compute K = SHA512( S )
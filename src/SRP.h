@@ -48,6 +48,7 @@ struct SRP6A {
   mbedtls_mpi s;          // s                            - randomly-generated salt (16 bytes)
   mbedtls_mpi x;          // x = H(s | H(I | ":" | P))    - salted, double-hash of username and password (64 bytes)
   mbedtls_mpi v;          // v = g^x %N                   - SRP-6A verifier (max 384 bytes)  
+  mbedtls_mpi kv;         // kv = k*v %N                  - computed once whenever v changes, since it is needed for every B (max 384 bytes)
   mbedtls_mpi b;          // b                            - randomly-generated private key for this HAP accessory (i.e. the SRP Server) (32 bytes)
   mbedtls_mpi B;          // B = k*v + g^b %N             - public key for this accessory (max 384 bytes)
   mbedtls_mpi A;          // A                            - public key RECEIVED from HAP Client (max 384 bytes)
@@ -68,16 +69,20 @@ struct SRP6A {
   char g3072[2]="\x05";     // g                          - 3072-bit Group generator
 
   uint8_t sharedSecret[64];                        // permanent storage for binary version of SHARED SECRET KEY for ease of use upstream
+  boolean keysReady=false;                         // flag indicating b and B have been precomputed (and not yet used) for the next Pair-Setup
 
   SRP6A();                                         // initializes N, G, and computes k
   
   void createVerifyCode(const char *setupCode, uint8_t *verifyCode, uint8_t *salt);
   void loadVerifyCode(uint8_t *verifyCode, uint8_t *salt);
+  void createKV();                                 // computes kv from k and v
   
   void getSalt();                                  // generates and stores random 16-byte salt, s
   void getPrivateKey();                            // generates and stores random 32-byte private key, b
   void getSetupCode(char *c);                      // generates and displays random 8-digit Pair-Setup code, P, in format XXX-XX-XXX
-  void createPublicKey();                          // computes x, v, and B from random s, P, and b
+  void createPublicKey();                          // loads precomputed b and B (or computes them now if not ready) for use in Pair-Setup
+  void precomputePublicKey();                      // computes random b and B = k*v + g^b %N ahead of time so Pair-Setup <M1> can be answered immediately
+  void computePublicKey();                         // computes B = k*v + g^b %N from the current b (which precomputePublicKey() sets randomly)
   void createSessionKey();                         // computes u from A and B, and then S from A, v, u, and b
   
   int loadTLV(kTLVType tag, mbedtls_mpi *mpi);     // load binary contents of mpi into a TLV record and set its length
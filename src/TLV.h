@@ -27,28 +27,52 @@
  
 #pragma once
 
-template <class tagType, int maxTags>
+// A table of TLVRecords defines every TAG a TLV structure supports.  The table is defined once, as a constexpr array, and
+// both sizes a TLV structure at compile time (using tlvCount() and tlvBytes() as its maxTags and maxBytes) and initializes it.
+
+template <class tagType>
+struct TLVRecord {
+  tagType tag;           // TAG
+  int maxLen;            // maximum length of VALUE buffer
+  const char *name;      // abbreviated name of this TAG
+};
+
+template <class tagType, int n>
+constexpr int tlvCount(const TLVRecord<tagType> (&)[n]){return(n);}              // number of records in table
+
+template <class tagType, int n>
+constexpr int tlvBytes(const TLVRecord<tagType> (&table)[n], int i=0){           // total bytes of the VALUE buffers of all records in table
+  return(i==n?0:table[i].maxLen+tlvBytes(table,i+1));
+}
+
+template <class tagType, int maxTags, int maxBytes>
 class TLV {
 
-  int cLen;              // total number of bytes in all defined TLV records, including TAG andf LEN (suitable for use as Content-Length in HTTP Body)
-  int numTags;           // actual number of tags defined
-  
+  static const uint8_t NO_SLOT=0xFF;   // index value for TAGs that do not have a TLV record
+
+  static_assert(maxTags>0 && maxTags<NO_SLOT,"TLV must have between 1 and 254 records");
+  static_assert(maxBytes>=maxTags,"TLV records must have VALUE buffers of at least one byte");
+
   struct tlv_t {
     tagType tag;         // TAG
     int len;             // LENGTH
-    uint8_t *val;        // VALUE buffer
+    uint8_t *val;        // VALUE buffer (points into arena)
     int maxLen;          // maximum length of VALUE buffer
     const char *name;          // abbreviated name of this TAG
   };
 
-  tlv_t tlv[maxTags];           // pointer to array of TLV record structures
-  tlv_t *find(tagType tag);     // returns pointer to TLV record with matching TAG (or NULL if no match)
+  tlv_t tlv[maxTags];           // array of TLV record structures
+  uint8_t index[256];           // maps each 8-bit TAG to its slot in tlv[] (or NO_SLOT if TAG has no record)
+  uint8_t arena[maxBytes];      // contiguous storage for the VALUE buffers of all TLV records
+  
+  tlv_t *find(tagType tag){     // returns pointer to TLV record with matching TAG (or NULL if no match)
+    uint8_t slot=index[(uint8_t)tag];
+    return(slot==NO_SLOT?NULL:tlv+slot);
+  }
 
 public:
 
-  TLV();
-  
-  int create(tagType tag, int maxLen, const char *name);   // creates a new TLV record of type 'tag' with 'maxLen' bytes and display 'name'
+  TLV(const TLVRecord<tagType> (&records)[maxTags]);      // creates one TLV record for each entry in table of 'records' (which must total maxBytes)
   
   void clear();                             // clear all TLV structures
   int val(tagType tag);                     // returns VAL for TLV with matching TAG (or -1 if no match)
@@ -59,62 +83,38 @@ public:
   void print();                             // prints all defined TLVs (those with length>0). For diagnostics/debugging only
   int unpack(uint8_t *tlvBuf, int nBytes);  // unpacks nBytes of TLV content from single byte buffer into individual TLV records (return 1 on success, 0 if fail) 
   int pack(uint8_t *tlvBuf);                // if tlvBuf!=NULL, packs all defined TLV records (LEN>0) into a single byte buffer, spitting large TLVs into separate 255-byte chunks.  Returns number of bytes (that would be) stored in buffer
-  int pack_old(uint8_t *buf);               // packs all defined TLV records (LEN>0) into a single byte buffer, spitting large TLVs into separate 255-byte records.  Returns number of bytes stored in buffer
+  int pack(uint8_t *tlvBuf, int offset, int nBytes);     // packs up to nBytes of the packed TLV stream, starting 'offset' bytes into the stream, into tlvBuf.  Returns number of bytes stored (0 when stream is exhausted)
   
 }; // TLV
 
 //////////////////////////////////////
-// TLV contructor()
+// TLV contructor(records)
 
-template<class tagType, int maxTags>
-TLV<tagType, maxTags>::TLV(){
-  numTags=0;
-}
+template<class tagType, int maxTags, int maxBytes>
+TLV<tagType, maxTags, maxBytes>::TLV(const TLVRecord<tagType> (&records)[maxTags]){
 
-//////////////////////////////////////
-// TLV create(tag, maxLen, name)
+  uint8_t *val=arena;
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::create(tagType tag, int maxLen, const char *name){
-  
-  if(numTags==maxTags){
-    Serial.print("\n*** ERROR: Can't create new TLC tag type with name='");
-    Serial.print(name);
-    Serial.print("' - exceeded number of records reserved\n\n");
-    return(0);
-  }
+  memset(index,NO_SLOT,sizeof(index));
 
-  tlv[numTags].tag=tag;
-  tlv[numTags].maxLen=maxLen;
-  tlv[numTags].name=name;
-  tlv[numTags].len=-1;
-  tlv[numTags].val=(uint8_t *)malloc(maxLen);
-  numTags++;  
-}
-
-//////////////////////////////////////
-// TLV find(tag)
-
-template<class tagType, int maxTags>
-typename TLV<tagType, maxTags>::tlv_t *TLV<tagType, maxTags>::find(tagType tag){
-
-  for(int i=0;i<numTags;i++){
-    if(tlv[i].tag==tag)
-      return(tlv+i);
+  for(int i=0;i<maxTags;i++){
+    tlv[i].tag=records[i].tag;
+    tlv[i].maxLen=records[i].maxLen;
+    tlv[i].name=records[i].name;
+    tlv[i].len=-1;
+    tlv[i].val=val;
+    index[(uint8_t)records[i].tag]=i;
+    val+=records[i].maxLen;
   }
-  
-  return(NULL);
 }
 
 //////////////////////////////////////
 // TLV clear()
 
-template<class tagType, int maxTags>
-void TLV<tagType, maxTags>::clear(){
-
-  cLen=0;
+template<class tagType, int maxTags, int maxBytes>
+void TLV<tagType, maxTags, maxBytes>::clear(){
 
-  for(int i=0;i<numTags;i++)
+  for(int i=0;i<maxTags;i++)
     tlv[i].len=-1;
 
 }
@@ -122,8 +122,8 @@ void TLV<tagType, maxTags>::clear(){
 //////////////////////////////////////
 // TLV val(tag)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::val(tagType tag){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::val(tagType tag){
 
   tlv_t *tlv=find(tag);
 
@@ -136,15 +136,14 @@ int TLV<tagType, maxTags>::val(tagType tag){
 //////////////////////////////////////
 // TLV val(tag, val)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::val(tagType tag, uint8_t val){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::val(tagType tag, uint8_t val){
 
   tlv_t *tlv=find(tag);
   
   if(tlv){
     tlv->val[0]=val;
     tlv->len=1;
-    cLen+=tlv->len+2;
     return(val);
   }
   
@@ -154,8 +153,8 @@ int TLV<tagType, maxTags>::val(tagType tag, uint8_t val){
 //////////////////////////////////////
 // TLV buf(tag)
 
-template<class tagType, int maxTags>
-uint8_t *TLV<tagType, maxTags>::buf(tagType tag){
+template<class tagType, int maxTags, int maxBytes>
+uint8_t *TLV<tagType, maxTags, maxBytes>::buf(tagType tag){
 
   tlv_t *tlv=find(tag);
 
@@ -168,18 +167,13 @@ uint8_t *TLV<tagType, maxTags>::buf(tagType tag){
 //////////////////////////////////////
 // TLV buf(tag, len)
 
-template<class tagType, int maxTags>
-uint8_t *TLV<tagType, maxTags>::buf(tagType tag, int len){
+template<class tagType, int maxTags, int maxBytes>
+uint8_t *TLV<tagType, maxTags, maxBytes>::buf(tagType tag, int len){
 
   tlv_t *tlv=find(tag);
   
   if(tlv && len<=tlv->maxLen){
     tlv->len=len;
-    cLen+=tlv->len;
-
-    for(int i=0;i<tlv->len;i+=255)
-      cLen+=2;
-    
     return(tlv->val);
   }
   
@@ -189,12 +183,12 @@ uint8_t *TLV<tagType, maxTags>::buf(tagType tag, int len){
 //////////////////////////////////////
 // TLV print()
 
-template<class tagType, int maxTags>
-void TLV<tagType, maxTags>::print(){
+template<class tagType, int maxTags, int maxBytes>
+void TLV<tagType, maxTags, maxBytes>::print(){
 
   char buf[3];
 
-  for(int i=0;i<numTags;i++){
+  for(int i=0;i<maxTags;i++){
     
     if(tlv[i].len>0){
       Serial.print(tlv[i].name);
@@ -214,62 +208,84 @@ void TLV<tagType, maxTags>::print(){
 }
 
 //////////////////////////////////////
-// TLV pack_old(buf)
+// TLV pack(tlvBuf)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::pack_old(uint8_t *buf){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::pack(uint8_t *tlvBuf){
 
   int n=0;
 
-  for(int i=0;i<numTags;i++){
+  for(tlv_t *t=tlv;t<tlv+maxTags;t++){
     
-    if(tlv[i].len>0){
-      *buf++=tlv[i].tag;
-      *buf++=tlv[i].len;
-      memcpy(buf,tlv[i].val,tlv[i].len);
-      buf+=tlv[i].len;
-      n+=tlv[i].len+2;      
-    } // len>0
+    if(t->len<=0)
+      continue;
+
+    n+=t->len+2*((t->len+254)/255);             // VALUE plus a TAG and LEN for every 255-byte fragment
+    
+    if(tlvBuf==NULL)
+      continue;
+      
+    uint8_t *val=t->val;
+    
+    for(int nBytes=t->len;nBytes>0;nBytes-=255,val+=255){
+      int fragLen=nBytes>255?255:nBytes;
+      *tlvBuf++=t->tag;
+      *tlvBuf++=fragLen;
+      memcpy(tlvBuf,val,fragLen);
+      tlvBuf+=fragLen;
+    } // fragment loop
     
   } // loop over all TLVs
 
-return(n);
-  
+  return(n);  
 }
 
 //////////////////////////////////////
-// TLV pack(tlvBuf)
+// TLV pack(tlvBuf, offset, nBytes)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::pack(uint8_t *tlvBuf){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::pack(uint8_t *tlvBuf, int offset, int nBytes){
 
-  int n=0;
-  int nBytes;
+  int n=0;                                        // number of bytes stored in tlvBuf
+  int pos=0;                                      // position in packed stream of start of current fragment
 
-  for(int i=0;i<numTags;i++){    
+  for(tlv_t *t=tlv;t<tlv+maxTags && n<nBytes;t++){
     
-    if((nBytes=tlv[i].len)>0){
-      for(int j=0;j<tlv[i].len;j+=255,nBytes-=255){
-        if(tlvBuf!=NULL){
-          *tlvBuf++=tlv[i].tag;
-          *tlvBuf++=nBytes>255?255:nBytes;
-          memcpy(tlvBuf,tlv[i].val+j,nBytes>255?255:nBytes);
-          tlvBuf+=nBytes>255?255:nBytes;
+    if(t->len<=0)
+      continue;
+      
+    for(int j=0;j<t->len && n<nBytes;j+=255){
+      int fragLen=t->len-j>255?255:t->len-j;
+
+      uint8_t hdr[2]={(uint8_t)t->tag,(uint8_t)fragLen};
+
+      while(offset<pos+fragLen+2 && n<nBytes){    // copy any part of this fragment (TAG, LEN, VALUE) at or beyond offset into tlvBuf
+        int k=offset-pos;
+        int m;
+        if(k<2){
+          tlvBuf[n]=hdr[k];
+          m=1;
+        } else {
+          m=fragLen+2-k<nBytes-n?fragLen+2-k:nBytes-n;          // bulk-copy as much of VALUE as will fit
+          memcpy(tlvBuf+n,t->val+j+k-2,m);
         }
-        n+=(nBytes>255?255:nBytes)+2;      
-      } // j-loop
-    } // len>0
+        n+=m;
+        offset+=m;
+      }
+      
+      pos+=fragLen+2;
+    } // fragment loop
     
   } // loop over all TLVs
 
-return(n);  
+  return(n);  
 }
 
 //////////////////////////////////////
 // TLV len(tag)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::len(tagType tag){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::len(tagType tag){
   
   tlv_t *tlv=find(tag);
 
@@ -282,59 +298,35 @@ int TLV<tagType, maxTags>::len(tagType tag){
 //////////////////////////////////////
 // TLV unpack(tlvBuf, nBytes)
 
-template<class tagType, int maxTags>
-int TLV<tagType, maxTags>::unpack(uint8_t *tlvBuf, int nBytes){
+template<class tagType, int maxTags, int maxBytes>
+int TLV<tagType, maxTags, maxBytes>::unpack(uint8_t *tlvBuf, int nBytes){
 
   clear();
 
-  tagType tag;
-  int tagLen;
-  uint8_t *val;
-  int currentLen;
-  int state=0;
+  uint8_t *end=tlvBuf+nBytes;
 
-  for(int i=0;i<nBytes;i++){
-    
-    switch(state){
-      
-      case 0:                                     // ready to read next tag
-        if((tag=(tagType)tlvBuf[i])==-1){         // read TAG; return with error if not found
-          clear();
-          return(0);
-        }
-        state=1;
-      break;
-
-      case 1:                                     // ready to read tag length
-        tagLen=tlvBuf[i];                         // read LEN
-        currentLen=len(tag);                      // get current length of existing tag
-        if(!(val=buf(tag,tagLen+currentLen))){    // get VAL Buffer for TAG and set LEN (returns NULL if LEN > maxLen)
-          clear();
-          return(0);
-        }
+  while(tlvBuf<end){
 
-        val+=currentLen;                          // move val to end of current length (tag repeats to load more than 255 bytes)
-          
-        if(tagLen==0)                             // no bytes to read
-          state=0;
-        else                                      // move to next state
-          state=2;
-      break;
-
-      case 2:                                     // ready to read another byte into VAL
-        *val=tlvBuf[i];                           // copy byte into VAL buffer
-        val++;                                    // increment VAL buffer (already checked for sufficient length above)
-        tagLen--;                                 // decrement number of bytes to continue copying
-        if(tagLen==0)                             // no more bytes to copy
-          state=0;
-      break;
+    if(end-tlvBuf<2){                             // TAG without a LEN
+      clear();
+      return(0);
+    }
+    
+    tlv_t *t=find((tagType)tlvBuf[0]);            // read TAG
+    int tagLen=tlvBuf[1];                         // read LEN
+    tlvBuf+=2;
+    
+    int currentLen=t?(t->len>0?t->len:0):0;       // get current length of existing tag (tag repeats to load more than 255 bytes)
 
-    } // switch
-  } // for-loop
+    if(!t || currentLen+tagLen>t->maxLen || tagLen>end-tlvBuf){   // unknown TAG, VALUE exceeds maxLen, or VALUE is truncated
+      clear();
+      return(0);
+    }
 
-  if(state==0)            // should always end back in state=0
-    return(1);            // return success
+    memcpy(t->val+currentLen,tlvBuf,tagLen);      // copy VALUE into end of VALUE buffer
+    t->len=currentLen+tagLen;
+    tlvBuf+=tagLen;
+  }
 
-  clear();
-  return(0);              // return fail
+  return(1);              // return success
 }
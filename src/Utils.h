@@ -29,6 +29,7 @@
 
 #include <Arduino.h>
 #include <driver/timer.h>
+#include <atomic>
 
 namespace Utils {
 
@@ -61,6 +62,37 @@ struct TempBuffer {
   
 };
 
+/////////////////////////////////////////////////
+// Lock-free ring buffer for passing items from
+// exactly one producer task to exactly one
+// consumer task (N must be a power of 2)
+
+template <class itemType, int N>
+struct SpscQueue {
+  itemType buf[N];
+  std::atomic<uint32_t> head{0};     // total number of items pushed (written only by producer)
+  std::atomic<uint32_t> tail{0};     // total number of items popped (written only by consumer)
+
+  boolean push(const itemType &item){                       // called by producer only; returns false if queue is full
+    uint32_t h=head.load(std::memory_order_relaxed);
+    if(h-tail.load(std::memory_order_acquire)==N)
+      return(false);
+    buf[h&(N-1)]=item;
+    head.store(h+1,std::memory_order_release);
+    return(true);
+  }
+
+  boolean pop(itemType &item){                              // called by consumer only; returns false if queue is empty
+    uint32_t t=tail.load(std::memory_order_relaxed);
+    if(t==head.load(std::memory_order_acquire))
+      return(false);
+    item=buf[t&(N-1)];
+    tail.store(t+1,std::memory_order_release);
+    return(true);
+  }
+  
+};
+
 ////////////////////////////////
 //         PushButton         //
 ////////////////////////////////